@@ -0,0 +1,50 @@
+//---------------------------------------------------------------------------------------------
+//
+// MiraOne UART capture decoder example.
+//
+// Listens to the traffic between a host and a MiraOne module, with the RX pin of Serial1
+// connected to one of the UART lines, and prints every frame on one line with the class,
+// type and payload decoded.
+//
+//---------------------------------------------------------------------------------------------
+#include <M2M_MiraOne.h>
+#include <M2M_MiraOneRegistry.h>
+
+MiraFrameDecoder decoder;
+uint8_t buffer[64];
+
+void setup()
+{
+	SerialUSB.begin(115200);
+	Serial1.begin(115200);
+	while (!SerialUSB);
+
+	SerialUSB.println(F("Mira capture decoder example"));
+}
+
+void loop()
+{
+	int count = Serial1.available();
+	if (count <= 0)
+	{
+		return;
+	}
+	if (count > (int)sizeof(buffer))
+	{
+		count = sizeof(buffer);
+	}
+	count = Serial1.readBytes(reinterpret_cast<char*>(buffer), count);
+	size_t position = 0;
+	while (position < (size_t)count)
+	{
+		position += decoder.feed(&buffer[position], count - position);
+		if (decoder.hasFrame())
+		{
+			MiraFrameView frame(decoder.getFrame(), decoder.getFrameLength());
+			SerialUSB.print(millis());
+			SerialUSB.print(' ');
+			MiraRegistry::printFrame(&SerialUSB, frame);
+			decoder.consumeFrame();
+		}
+	}
+}
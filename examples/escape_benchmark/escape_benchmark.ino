@@ -0,0 +1,129 @@
+//---------------------------------------------------------------------------------------------
+//
+// MiraOne TX escape encoder benchmark.
+//
+// Encodes a full size data frame with random, all-zero and all-0xE1 payloads, comparing the
+// run based encoder used by MiraOneMessage::write with a reference byte-by-byte encoder.
+// Output goes to a counting Print, so only the encoding and CRC cost is measured.
+//
+//---------------------------------------------------------------------------------------------
+#include <M2M_MiraOne.h>
+
+#define PAYLOAD_SIZE		255
+#define ITERATIONS			1000
+
+class NullPrint : public Print
+{
+public:
+	size_t write(uint8_t value) override
+	{
+		_checksum += value;
+		return 1;
+	}
+	size_t write(const uint8_t* buffer, size_t size) override
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			_checksum += buffer[i];
+		}
+		return size;
+	}
+	uint32_t getChecksum()
+	{
+		return _checksum;
+	}
+
+private:
+	uint32_t _checksum = 0;
+};
+
+uint8_t payload[PAYLOAD_SIZE];
+NullPrint output;
+
+size_t encodeByteByByte(Print* print, const uint8_t* data, size_t length, uint16_t& crc)
+{
+	size_t written = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		MiraOneMessage::addToCrc(crc, data[i]);
+		if (data[i] == MIRA_CHAR_STC || data[i] == MIRA_CHAR_ESC)
+		{
+			written += print->write(static_cast<uint8_t>(MIRA_CHAR_ESC));
+			written += print->write(static_cast<uint8_t>(~data[i]));
+		}
+		else
+		{
+			written += print->write(data[i]);
+		}
+	}
+	return written;
+}
+
+size_t encodeRuns(Print* print, const uint8_t* data, size_t length, uint16_t& crc)
+{
+	crc = MiraOneMessage::updateCrc(crc, data, length);
+	return MiraOneMessage::writeEscaped(print, data, length);
+}
+
+void runBenchmark(const char* name)
+{
+	uint16_t crc = 0;
+	size_t written = 0;
+	uint32_t start = micros();
+	for (uint16_t i = 0; i < ITERATIONS; i++)
+	{
+		crc = 0;
+		written = encodeByteByByte(&output, payload, PAYLOAD_SIZE, crc);
+	}
+	uint32_t byteTime = micros() - start;
+	uint16_t byteCrc = crc;
+
+	start = micros();
+	for (uint16_t i = 0; i < ITERATIONS; i++)
+	{
+		crc = 0;
+		written = encodeRuns(&output, payload, PAYLOAD_SIZE, crc);
+	}
+	uint32_t runTime = micros() - start;
+
+	Serial.print(name);
+	Serial.print(F(": "));
+	Serial.print(written);
+	Serial.print(F(" bytes encoded, byte-by-byte "));
+	Serial.print(byteTime / ITERATIONS);
+	Serial.print(F(" us, runs "));
+	Serial.print(runTime / ITERATIONS);
+	Serial.print(F(" us"));
+	if (crc != byteCrc)
+	{
+		Serial.print(F(" (CRC MISMATCH)"));
+	}
+	Serial.println();
+}
+
+void setup()
+{
+	Serial.begin(115200);
+	while (!Serial);
+
+	Serial.println(F("MiraOne escape encoder benchmark"));
+	randomSeed(analogRead(0));
+	for (uint16_t i = 0; i < PAYLOAD_SIZE; i++)
+	{
+		payload[i] = random(256);
+	}
+	runBenchmark("Random");
+
+	memset(payload, 0, sizeof(payload));
+	runBenchmark("All zero");
+
+	memset(payload, MIRA_CHAR_STC, sizeof(payload));
+	runBenchmark("All 0xE1");
+
+	Serial.print(F("Checksum: "));
+	Serial.println(output.getChecksum());
+}
+
+void loop()
+{
+}
@@ -1,20 +1,89 @@
+//---------------------------------------------------------------------------------------------
+//
+// MiraOne IoT gateway example.
+//
+// Data received from the mesh network is batched per ThingSpeak channel and posted with the
+// ThingSpeak bulk update API, so one HTTP request carries many radio messages. Frames are only
+// taken from the radio while the bridge has room, so a slow uplink does not lose data that
+// has already been received.
+//
+// Nodes are expected to send MiraOnePayloadv1 or MiraOnePayloadv3 payloads. Odd node
+// addresses go to the first channel and even ones to the second.
+//
+//---------------------------------------------------------------------------------------------
+#include <WiFi101.h>
+#include <M2M_MiraOne.h>
+#include <M2M_MiraOneBridge.h>
+#include <M2M_MiraOneHttpUplink.h>
 
+#define WIFI_SSID				"ssid"
+#define WIFI_PASSWORD			"password"
 
+#define RF_NETWORK_ID			1234
+#define RF_NETWORK_AESKEY		"0123456789abcdef"
 
-#define RF_NETWORK_ID		"1234"
-#define RF_NETWORK_AESKEY	"01234567890abcdef0123456789abcdef"
-
-#define THINGSPEAK_API_KEY1 	"XXX"
+#define THINGSPEAK_HOST			"api.thingspeak.com"
+#define THINGSPEAK_API_KEY1		"XXX"
 #define THINGSPEAK_API_KEY2		"YYY"
 #define THINGSPEAK_CHANNELID1	"AA"
 #define THINGSPEAK_CHANNELID2	"BB"
-#define THINGSPEAK_URL			"https://api.thingspeak.com/update.json"
 
+#define BATCH_MAX_AGE			15000	// ms, ThingSpeak accepts one update per 15 s per channel
+#define RADIO_BUDGET			2000	// us per loop spent on the radio
+#define MAX_RECORD_SIZE			255
 
+const char* channelIds[] = { THINGSPEAK_CHANNELID1, THINGSPEAK_CHANNELID2 };
+const char* apiKeys[] = { THINGSPEAK_API_KEY1, THINGSPEAK_API_KEY2 };
 
-#include "M2M_Mira.h"
+// Each record is the 8 byte node address followed by the node data
+class ThingSpeakUplink : public MiraHttpUplink
+{
+public:
+	ThingSpeakUplink(Client& client) : MiraHttpUplink(client, THINGSPEAK_HOST)
+	{
+	}
 
-M2M_Mira mira(Serial1);
+protected:
+	void writePath(Print* out, const MiraBridgeBatch& batch) override
+	{
+		out->print(F("/channels/"));
+		out->print(channelIds[batch.channel]);
+		out->print(F("/bulk_update.json"));
+	}
+
+	void writeBody(Print* out, const MiraBridgeBatch& batch) override
+	{
+		out->print(F("{\"write_api_key\":\""));
+		out->print(apiKeys[batch.channel]);
+		out->print(F("\",\"updates\":["));
+		uint16_t offset = 0;
+		uint16_t previousAge = 0;
+		MiraBridgeRecord record;
+		bool first = true;
+		while (batch.getRecord(offset, record))
+		{
+			if (!first)
+			{
+				out->print(',');
+			}
+			first = false;
+			out->print(F("{\"delta_t\":"));
+			out->print((record.age - previousAge) / 1000);
+			out->print(F(",\"field1\":\""));
+			writeHex(out, &record.data[sizeof(IEEE_EUI64)], record.length - sizeof(IEEE_EUI64));
+			out->print(F("\",\"field2\":\""));
+			writeHex(out, record.data, sizeof(IEEE_EUI64));
+			out->print(F("\"}"));
+			previousAge = record.age;
+		}
+		out->print(F("]}"));
+	}
+};
+
+MiraOne mira(Serial1);
+WiFiClient client;
+ThingSpeakUplink uplink(client);
+MiraBridge bridge(uplink);
 
 void setup()
 {
@@ -22,21 +91,75 @@ void setup()
 	Serial1.begin(115200);
 	while (!SerialUSB);
 
-	Serial.println("Mira IoT gateway example");
-	mira.begin(RF_NETWORK_ID, RF_NETWORK_AESKEY, true);
-
+	SerialUSB.println(F("Mira IoT gateway example"));
+	while (WiFi.begin(WIFI_SSID, WIFI_PASSWORD) != WL_CONNECTED)
+	{
+		delay(5000);
+	}
+	mira.begin(true, "Gateway", RF_NETWORK_ID, RF_NETWORK_AESKEY);
+	// Only data is forwarded, network statistics are dropped in the decoder
+	mira.setSubscription(MIRA_MESSAGE_CLASS_NETSTATMESSAGE, false);
+	bridge.setMaxAge(BATCH_MAX_AGE);
 }
 
 void loop()
 {
-	if (mira.available)
+	mira.update(RADIO_BUDGET);
+	// Backpressure, frames stay queued in MiraOne until the bridge has room for them
+	while (bridge.canAccept(0, MAX_RECORD_SIZE) && bridge.canAccept(1, MAX_RECORD_SIZE))
 	{
-		M2M_MiraMessage message = mira.receive();
-		switch (message.messageType)
+		MiraOneMessage* message = mira.getQueuedMessage();
+		if (message == nullptr)
 		{
-			case MiraMessageType.DataMessage:
-				sendDataToThingspeak(message);
-				break;
+			break;
 		}
+		forwardMessage(message);
+		delete message;
+	}
+	bridge.update();
+}
+
+void forwardMessage(MiraOneMessage* message)
+{
+	if (message->getMessageClass() != MIRA_MESSAGE_CLASS_DATAMESSAGE ||
+		message->getMessageType() != MIRA_MESSAGE_TYPE_DATA_RECEIVED)
+	{
+		return;
+	}
+	const IEEE_EUI64* address;
+	const uint8_t* data;
+	uint8_t length;
+	uint8_t* payload = message->getData();
+	if (payload[0] == 1 && message->getDataSize() >= sizeof(MiraOnePayloadv1))
+	{
+		MiraOnePayloadv1* v1 = reinterpret_cast<MiraOnePayloadv1*>(payload);
+		address = &v1->miraAddress;
+		data = v1->data;
+		length = v1->dataLength;
+	}
+	else if (payload[0] == 3 && message->getDataSize() >= sizeof(MiraOnePayloadv3))
+	{
+		MiraOnePayloadv3* v3 = reinterpret_cast<MiraOnePayloadv3*>(payload);
+		address = &v3->miraAddress;
+		data = v3->data;
+		length = v3->dataLength;
+	}
+	else
+	{
+		return;
+	}
+	// dataLength comes from the node, do not read past the frame
+	uint8_t available = message->getDataSize() - (data - payload);
+	if (length > available)
+	{
+		length = available;
+	}
+	uint8_t record[MAX_RECORD_SIZE];
+	if (length > sizeof(record) - sizeof(IEEE_EUI64))
+	{
+		length = sizeof(record) - sizeof(IEEE_EUI64);
 	}
+	memcpy(record, address, sizeof(IEEE_EUI64));
+	memcpy(&record[sizeof(IEEE_EUI64)], data, length);
+	bridge.add(address->data[7] & 1 ? 0 : 1, record, sizeof(IEEE_EUI64) + length);
 }
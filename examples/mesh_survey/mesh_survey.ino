@@ -0,0 +1,88 @@
+//---------------------------------------------------------------------------------------------
+//
+// MiraOne mesh latency survey example.
+//
+// Pings every node in the list a number of times with several pings in flight, then prints
+// the round trip min, median, 99th percentile and max in ms, and the loss, for each node.
+//
+//---------------------------------------------------------------------------------------------
+#include <M2M_MiraOne.h>
+#include <M2M_MiraOneSurvey.h>
+
+#define RF_NETWORK_ID			1234
+#define RF_NETWORK_AESKEY		"0123456789abcdef"
+
+#define PINGS_PER_NODE			10
+#define PINGS_IN_FLIGHT			4
+
+IEEE_EUI64 nodes[] =
+{
+	{ { 0x00, 0x12, 0x4b, 0x00, 0x01, 0x02, 0x03, 0x04 } },
+	{ { 0x00, 0x12, 0x4b, 0x00, 0x01, 0x02, 0x03, 0x05 } },
+	{ { 0x00, 0x12, 0x4b, 0x00, 0x01, 0x02, 0x03, 0x06 } }
+};
+
+MiraOne mira(Serial1);
+MiraPingSurvey survey(mira);
+
+void printAddress(const IEEE_EUI64& address)
+{
+	for (uint8_t i = 0; i < sizeof(address.data); i++)
+	{
+		if (address.data[i] < 0x10)
+		{
+			SerialUSB.print('0');
+		}
+		SerialUSB.print(address.data[i], HEX);
+	}
+}
+
+void printResults()
+{
+	SerialUSB.print(F("Survey done in "));
+	SerialUSB.print(survey.getElapsed());
+	SerialUSB.print(F(" ms, reachable "));
+	SerialUSB.print(survey.getReachableCount());
+	SerialUSB.print('/');
+	SerialUSB.println(survey.getNodeCount());
+	MiraSurveyResult result;
+	for (uint16_t i = 0; i < survey.getNodeCount(); i++)
+	{
+		survey.getResult(i, result);
+		printAddress(result.address);
+		SerialUSB.print(F(" min "));
+		SerialUSB.print(result.min);
+		SerialUSB.print(F(" median "));
+		SerialUSB.print(result.median);
+		SerialUSB.print(F(" p99 "));
+		SerialUSB.print(result.p99);
+		SerialUSB.print(F(" max "));
+		SerialUSB.print(result.max);
+		SerialUSB.print(F(" loss "));
+		SerialUSB.print(result.loss * 100, 0);
+		SerialUSB.println('%');
+	}
+}
+
+void setup()
+{
+	SerialUSB.begin(115200);
+	Serial1.begin(115200);
+	while (!SerialUSB);
+
+	SerialUSB.println(F("Mira mesh survey example"));
+	mira.begin(true, "Survey", RF_NETWORK_ID, RF_NETWORK_AESKEY);
+	survey.begin(nodes, sizeof(nodes) / sizeof(nodes[0]), PINGS_PER_NODE, PINGS_IN_FLIGHT);
+}
+
+void loop()
+{
+	mira.update();
+	if (!survey.update())
+	{
+		printResults();
+		// Run it again after a while
+		delay(60000);
+		survey.begin(nodes, sizeof(nodes) / sizeof(nodes[0]), PINGS_PER_NODE, PINGS_IN_FLIGHT);
+	}
+}
@@ -0,0 +1,121 @@
+//---------------------------------------------------------------------------------------------
+//
+// MiraOne pseudo terminal loopback example, for Linux builds.
+//
+// Opens a pseudo terminal pair with MiraPosixSerial. One side plays the module and answers
+// every GET_VERSION request with a version response, the other side sends a request once a
+// second and prints the decoded response with the round-trip time. No radio module is needed.
+//
+//---------------------------------------------------------------------------------------------
+#include <M2M_MiraOne.h>
+#include <M2M_MiraOnePosixSerial.h>
+
+#define REQUEST_INTERVAL		1000	// ms
+#define RESPONSE_TIMEOUT		100		// ms
+
+MiraPosixSerial modulePort;
+MiraPosixSerial hostPort;
+MiraFrameDecoder moduleDecoder;
+MiraFrameDecoder hostDecoder;
+uint8_t messageIndex = 0;
+uint32_t requestAt = 0;
+uint32_t lastRequest = 0;
+bool waiting = false;
+
+// Feeds bytes to the decoder until a frame is complete, so nothing after it is lost
+bool receiveFrame(MiraPosixSerial& port, MiraFrameDecoder& decoder)
+{
+	while (!decoder.hasFrame())
+	{
+		int data = port.read();
+		if (data < 0)
+		{
+			return false;
+		}
+		uint8_t byte = data;
+		decoder.feed(&byte, 1);
+	}
+	return true;
+}
+
+void serviceModule()
+{
+	if (!receiveFrame(modulePort, moduleDecoder))
+	{
+		return;
+	}
+	MiraFrameView view(moduleDecoder.getFrame(), moduleDecoder.getFrameLength());
+	MiraGetVersionFrame request;
+	if (request.decode(view))
+	{
+		MiraVersionFrame response;
+		response.payload.major = 1;
+		response.payload.minor = 4;
+		response.write(&modulePort, request.messageIndex);
+	}
+	moduleDecoder.consumeFrame();
+}
+
+void serviceHost()
+{
+	if (!receiveFrame(hostPort, hostDecoder))
+	{
+		return;
+	}
+	MiraFrameView view(hostDecoder.getFrame(), hostDecoder.getFrameLength());
+	MiraVersionFrame response;
+	if (response.decode(view) && response.messageIndex == messageIndex)
+	{
+		Serial.print(F("Version "));
+		Serial.print(response.payload.major);
+		Serial.print('.');
+		Serial.print(response.payload.minor);
+		Serial.print(F(", round trip "));
+		Serial.print(micros() - requestAt);
+		Serial.println(F(" us"));
+		waiting = false;
+	}
+	hostDecoder.consumeFrame();
+}
+
+void setup()
+{
+	Serial.begin(115200);
+
+	char peerName[64];
+	if (!modulePort.beginPty(peerName, sizeof(peerName)) || !hostPort.begin(peerName, 921600))
+	{
+		Serial.println(F("Could not open a pseudo terminal"));
+		return;
+	}
+	Serial.print(F("Mira pseudo terminal loopback on "));
+	Serial.println(peerName);
+}
+
+void loop()
+{
+	if (hostPort.getFd() < 0)
+	{
+		delay(REQUEST_INTERVAL);
+		return;
+	}
+	if (waiting && millis() - lastRequest > RESPONSE_TIMEOUT)
+	{
+		Serial.println(F("Timeout waiting for response"));
+		waiting = false;
+	}
+	if (!waiting && millis() - lastRequest >= REQUEST_INTERVAL)
+	{
+		MiraGetVersionFrame request;
+		messageIndex++;
+		lastRequest = millis();
+		requestAt = micros();
+		if (request.write(&hostPort, messageIndex) != 0)
+		{
+			waiting = true;
+		}
+	}
+	modulePort.waitReadable(1);
+	serviceModule();
+	serviceHost();
+}
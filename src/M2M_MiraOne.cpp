@@ -18,13 +18,49 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
-// Constructor
+// Constructor/Destructor
 //
 MiraOne::MiraOne(Stream& stream, uint8_t resetPin, MiraAntenna antenna)
 {
 	_stream = &stream;
 	_resetPin = resetPin;
 	_antenna = antenna;
+	_currentMessageId = 0;
+	watchdogcallback = nullptr;
+	deliverycallback = nullptr;
+	_sendWindow = MIRA_SEND_WINDOW;
+	_sendUsed = 0;
+	_retryLimit = MIRA_RETRY_LIMIT;
+	_unmatchedResponseCount = 0;
+	_txRoomSeen = false;
+	memset(_inFlight, 0, sizeof(_inFlight));
+	memset(_requests, 0, sizeof(_requests));
+	_rtt[static_cast<uint8_t>(MiraRttClass::command)].setLimits(MIRA_RTT_COMMAND_FLOOR, MIRA_RTT_COMMAND_CEILING);
+	_rtt[static_cast<uint8_t>(MiraRttClass::settings)].setLimits(MIRA_RTT_SETTINGS_FLOOR, MIRA_RTT_SETTINGS_CEILING);
+	_rtt[static_cast<uint8_t>(MiraRttClass::data)].setLimits(MIRA_RTT_DATA_FLOOR, MIRA_RTT_DATA_CEILING);
+	_rtt[static_cast<uint8_t>(MiraRttClass::mesh)].setLimits(MIRA_RTT_MESH_FLOOR, MIRA_RTT_MESH_CEILING);
+	_transmitAt = 0;
+	_transmitClass = 0;
+	_transmitIndex = 0;
+	_lastStatus = MiraStatus::ok;
+	_lastErrorCode = 0;
+	_awaitingAck = false;
+	_rxHead = nullptr;
+	_rxTail = nullptr;
+	_rxCount = 0;
+	_rxPosition = 0;
+	_rxLength = 0;
+	_lastRxAt = 0;
+	_rxReadAt = 0;
+	_budgetStart = 0;
+	_budget = 0;
+	_waiting = false;
+	_hasVersion = false;
+	_hasAddress = false;
+	_resetState = MiraResetState::idle;
+	_resetAt = 0;
+	_resetMaxWait = MIRA_RESET_MAX_WAIT;
+	_probeActive = false;
 	if (resetPin != NOT_A_PIN)
 	{
 		pinMode(resetPin, OUTPUT);
@@ -32,6 +68,22 @@ MiraOne::MiraOne(Stream& stream, uint8_t resetPin, MiraAntenna antenna)
 	}
 }
 
+MiraOne::~MiraOne()
+{
+	for (uint8_t i = 0; i < MIRA_MAX_SEND_WINDOW; i++)
+	{
+		if (_inFlight[i].message != nullptr)
+		{
+			delete _inFlight[i].message;
+		}
+	}
+	MiraOneMessage* message;
+	while ((message = dequeueReceived()) != nullptr)
+	{
+		delete message;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Infrastructure
@@ -48,11 +100,42 @@ void MiraOne::begin(bool root, const char* name, uint16_t networkId, const char*
 		becomeNetworkRoot();
 	}
 	commitSettings();
+	refreshIdentity();
 }
 
 void MiraOne::update()
 {
-	// Nothing for now
+	update(0);
+}
+
+bool MiraOne::update(uint32_t budgetMicros)
+{
+	// Receive and transmit stop once the budget is used, whatever is left stays buffered
+	// for the next call. Returns true if work remains.
+	_budgetStart = micros();
+	_budget = budgetMicros;
+	serviceReset();
+	serviceRx();
+	serviceRetransmissions();
+	serviceRequests();
+	serviceTxQueue();
+#ifdef MIRA_COROUTINES
+	_executor.run();
+#endif
+	_budget = 0;
+	callWatchdog();
+	return _rxPosition < _rxLength || _stream->available() > 0 || _scheduler.getCount() > 0 || _txRing.getCount() > 0;
+}
+
+bool MiraOne::canEncodeNow()
+{
+	// Frames can skip the transmit queue when nothing is waiting ahead of them
+	return _scheduler.getCount() == 0 && (isReady() || _resetState == MiraResetState::failed) && hasBudget();
+}
+
+bool MiraOne::hasBudget()
+{
+	return _budget == 0 || micros() - _budgetStart < _budget;
 }
 
 uint8_t MiraOne::getNextMessageId()
@@ -60,6 +143,17 @@ uint8_t MiraOne::getNextMessageId()
 	return _currentMessageId++;
 }
 
+IEEE_EUI64 MiraOne::getAddress()
+{
+	// All zero if the module could not be read
+	IEEE_EUI64 address;
+	if (!getEUI64Info(&address))
+	{
+		memset(&address, 0, sizeof(address));
+	}
+	return address;
+}
+
 void MiraOne::flush()
 {
 	MO_LOG_TRACE_START(F("Flush "));
@@ -74,12 +168,43 @@ void MiraOne::flush()
 
 void MiraOne::reset()
 {
+	// Blocks until the module answers or the maximum wait has passed
+	beginReset(MIRA_RESET_MAX_WAIT);
+	while (_resetState != MiraResetState::ready && _resetState != MiraResetState::failed)
+	{
+		update();
+		delay(1);
+	}
+}
+
+void MiraOne::beginReset(uint32_t maxWait)
+{
+	// Driven by update(). The module is ready on the first valid frame it sends after the
+	// reset pin is released, or when it acknowledges a probe. Queued frames wait until then.
 	MO_LOG_TRACE(F("Resetting Mira module"));
-	digitalWrite(_resetPin, LOW);
-	delay(200);
-	digitalWrite(_resetPin, HIGH);
-	delay(500);
-	callWatchdog();
+	_hasVersion = false;
+	_hasAddress = false;
+	_resetMaxWait = maxWait;
+	_resetAt = millis();
+	if (_resetPin != NOT_A_PIN)
+	{
+		digitalWrite(_resetPin, LOW);
+		_resetState = MiraResetState::holding;
+	}
+	else
+	{
+		_resetState = MiraResetState::booting;
+	}
+}
+
+MiraResetState MiraOne::getResetState()
+{
+	return _resetState;
+}
+
+bool MiraOne::isReady()
+{
+	return _resetState == MiraResetState::idle || _resetState == MiraResetState::ready;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -91,6 +216,88 @@ void MiraOne::setLogger(Logger* logger)
 	_logger = logger;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Duplicate suppression
+//
+void MiraOne::setDuplicateFilter(MiraDuplicateFilter* filter)
+{
+	_duplicateFilter = filter;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Frame handlers
+//
+bool MiraOne::setFrameHandler(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	return _dispatcher.setHandler(messageClass, messageType, framehandler, context);
+}
+
+bool MiraOne::setFrameHandler(uint8_t messageClass, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	return _dispatcher.setHandler(messageClass, framehandler, context);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Receive filtering
+//
+void MiraOne::setSubscription(uint8_t messageClass, uint8_t messageType, bool subscribed)
+{
+	if (messageType >= 16)
+	{
+		return;
+	}
+	uint16_t mask = _decoder.getSubscription(messageClass);
+	if (subscribed)
+	{
+		mask |= 1 << messageType;
+	}
+	else
+	{
+		mask &= ~(1 << messageType);
+	}
+	_decoder.setSubscription(messageClass, mask);
+}
+
+void MiraOne::setSubscription(uint8_t messageClass, bool subscribed)
+{
+	// ACK and ERROR are kept, the library needs them for commands and DATA_SEND
+	uint16_t keep = 1 << MIRA_MESSAGE_TYPE_ACK | 1 << MIRA_MESSAGE_TYPE_ERROR;
+	_decoder.setSubscription(messageClass, subscribed ? 0xffff : keep);
+}
+
+uint32_t MiraOne::getRxFilteredCount()
+{
+	return _decoder.getFilteredCount();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Receive timing
+//
+void MiraOne::setRxByteTime(uint16_t micros)
+{
+	// 10000000 / baud rate for 8N1, dates bytes read in one block back to their arrival
+	_decoder.setByteTime(micros);
+}
+
+MiraHistogram& MiraOne::getRxFrameHistogram()
+{
+	return _rxFrameTime;
+}
+
+MiraHistogram& MiraOne::getRxQueueHistogram()
+{
+	return _rxQueueTime;
+}
+
+MiraHistogram& MiraOne::getOneWayHistogram()
+{
+	return _oneWayTime;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Management
@@ -99,7 +306,7 @@ bool MiraOne::setNetworkCredentials(const uint16_t networkId, const char* aesKey
 {
 	MO_LOG_TRACE("Setting network credentials");
 	MiraOneMessage* message = MiraOneMessage::getSetCredentialsMessage(networkId, aesKey);
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR(F("setNetworkCredentials: Send failure"));
@@ -109,7 +316,7 @@ bool MiraOne::setNetworkCredentials(const uint16_t networkId, const char* aesKey
 	callWatchdog();
 	delete message;
 	MO_LOG_TRACE(F("Waiting for response"));
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (response == nullptr)
 	{
 		delete response;
@@ -118,7 +325,6 @@ bool MiraOne::setNetworkCredentials(const uint16_t networkId, const char* aesKey
 		return false;
 	}
 	callWatchdog();
-	// Check result
 	delete response;
 	return true;
 }
@@ -126,7 +332,7 @@ bool MiraOne::setNetworkCredentials(const uint16_t networkId, const char* aesKey
 bool MiraOne::becomeNetworkRoot()
 {
 	MiraOneMessage* message = MiraOneMessage::getBecomeNetworkRootMessage();
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR(F("becomeNetworkRoot: Send failure"));
@@ -135,7 +341,7 @@ bool MiraOne::becomeNetworkRoot()
 	}
 	delete message;
 	callWatchdog();
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (response == nullptr)
 	{
 		delete response;
@@ -143,7 +349,6 @@ bool MiraOne::becomeNetworkRoot()
 		callWatchdog();
 		return false;
 	}
-	// Check status
 	delete response;
 	callWatchdog();
 	return true;
@@ -152,7 +357,7 @@ bool MiraOne::becomeNetworkRoot()
 bool MiraOne::setName(const char* name)
 {
 	MiraOneMessage* message = MiraOneMessage::getSetNameMessage(name);
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR(F("setName: Send failure"));
@@ -162,7 +367,7 @@ bool MiraOne::setName(const char* name)
 	delete message;
 	callWatchdog();
 	MO_LOG_TRACE(F("Waiting for response"));
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (response == nullptr)
 	{
 		delete response;
@@ -170,7 +375,6 @@ bool MiraOne::setName(const char* name)
 		callWatchdog();
 		return false;
 	}
-	// Check status
 	delete response;
 	callWatchdog();
 	return true;
@@ -179,7 +383,7 @@ bool MiraOne::setName(const char* name)
 bool MiraOne::setAntenna(MiraAntenna antenna)
 {
 	MiraOneMessage* message = MiraOneMessage::getSetAntennaMessage(antenna);
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR(F("commitSettings: Send failure"));
@@ -188,7 +392,7 @@ bool MiraOne::setAntenna(MiraAntenna antenna)
 	}
 	delete message;
 	callWatchdog();
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (response == nullptr)
 	{
 		delete response;
@@ -196,7 +400,6 @@ bool MiraOne::setAntenna(MiraAntenna antenna)
 		callWatchdog();
 		return false;
 	}
-	// Check status
 	delete response;
 	callWatchdog();
 	return true;
@@ -205,7 +408,7 @@ bool MiraOne::setAntenna(MiraAntenna antenna)
 bool MiraOne::commitSettings()
 {
 	MiraOneMessage* message = MiraOneMessage::getCommitSettingsMessage();
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR(F("commitSettings: Send failure"));
@@ -214,7 +417,7 @@ bool MiraOne::commitSettings()
 	}
 	delete message;
 	callWatchdog();
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (response == nullptr)
 	{
 		delete response;
@@ -222,16 +425,60 @@ bool MiraOne::commitSettings()
 		callWatchdog();
 		return false;
 	}
-	// Check status
 	delete response;
 	callWatchdog();
 	return true;
 }
 
 bool MiraOne::getVersion(VersionInfo& version)
+{
+	// Served from the cache once read, until reset() or refreshIdentity()
+	if (!_hasVersion && !queryVersion(_version))
+	{
+		return false;
+	}
+	_hasVersion = true;
+	version = _version;
+	return true;
+}
+
+bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
+{
+	if (!_hasAddress && !queryEUI64(_address))
+	{
+		return false;
+	}
+	_hasAddress = true;
+	*buffer = _address;
+	return true;
+}
+
+bool MiraOne::refreshIdentity()
+{
+	_hasVersion = false;
+	_hasAddress = false;
+	VersionInfo version;
+	IEEE_EUI64 address;
+	bool result = getVersion(version);
+	return getEUI64Info(&address) && result;
+}
+
+MiraStatus MiraOne::getLastStatus()
+{
+	// Outcome of the last blocking command
+	return _lastStatus;
+}
+
+uint8_t MiraOne::getLastErrorCode()
+{
+	// Error code of the last ERROR response
+	return _lastErrorCode;
+}
+
+bool MiraOne::queryVersion(VersionInfo& version)
 {
 	MiraOneMessage* message = MiraOneMessage::getGetVersionMessage();
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR("Send failure");
@@ -243,7 +490,7 @@ bool MiraOne::getVersion(VersionInfo& version)
 	MO_LOG_TRACE("Waiting for response");
 
 	// This is the ack message
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (!response)
 	{
 		delete response;
@@ -256,7 +503,7 @@ bool MiraOne::getVersion(VersionInfo& version)
 	callWatchdog();
 
 	// This is the version message
-	response = getNextMessage();
+	response = getResponse();
 	if (!response)
 	{
 		delete response;
@@ -265,6 +512,14 @@ bool MiraOne::getVersion(VersionInfo& version)
 		return false;
 	}	
 	MO_LOG_TRACE("Got reply message");
+	if (response->getDataSize() < 2)
+	{
+		delete response;
+		_lastStatus = MiraStatus::invalidReply;
+		MO_LOG_ERROR("Invalid version reply");
+		callWatchdog();
+		return false;
+	}
 	uint8_t* data = response->getData();
 	version.major = *data++;
 	version.minor = *data;
@@ -273,10 +528,10 @@ bool MiraOne::getVersion(VersionInfo& version)
 	return true;
 }
 
-bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
+bool MiraOne::queryEUI64(IEEE_EUI64& address)
 {
 	MiraOneMessage* message = MiraOneMessage::getGetEUI64InfoMessage();
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR("Send failure");
@@ -288,7 +543,7 @@ bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
 	MO_LOG_TRACE("Waiting for response");
 
 	// This is the ack message
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (!response)
 	{
 		delete response;
@@ -297,13 +552,11 @@ bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
 		return false;
 	}
 	MO_LOG_TRACE("Got response message");
-	uint8_t* data = response->getData();
-	memcpy(buffer, data, 8);
 	delete response;
 	callWatchdog();
 
-	// This is the version message
-	response = getNextMessage();
+	// This is the EUI64 message
+	response = getResponse();
 	if (!response)
 	{
 		delete response;
@@ -312,8 +565,15 @@ bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
 		return false;
 	}	
 	MO_LOG_TRACE("Got reply message");
-	data = response->getData();
-	memcpy(buffer, data, 8);
+	if (response->getDataSize() < sizeof(IEEE_EUI64))
+	{
+		delete response;
+		_lastStatus = MiraStatus::invalidReply;
+		MO_LOG_ERROR("Invalid EUI64 reply");
+		callWatchdog();
+		return false;
+	}
+	memcpy(&address, response->getData(), sizeof(IEEE_EUI64));
 	delete response;
 	callWatchdog();
 	return true;	
@@ -327,7 +587,7 @@ bool MiraOne::getEUI64Info(IEEE_EUI64* buffer)
 bool MiraOne::getNetworkStatistics(uint8_t interval)
 {
 	MiraOneMessage* message = MiraOneMessage::getNetworkGetStatisticsMessage(interval);	
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR("Send failure");
@@ -339,7 +599,7 @@ bool MiraOne::getNetworkStatistics(uint8_t interval)
 
 	MO_LOG_TRACE(F("Waiting for response"));
 	// This is the ack message
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (!response)
 	{
 		delete response;
@@ -357,7 +617,7 @@ bool MiraOne::networkPing(IEEE_EUI64 address)
 {
 	// Network ping can only be sent to a specific node, so the UEI64 address is mandatory	
 	MiraOneMessage* message = MiraOneMessage::getNetworkPingMessage(address);
-	if (!send(message))
+	if (!transmit(message))
 	{
 		delete message;
 		MO_LOG_ERROR("Send failure");
@@ -369,7 +629,7 @@ bool MiraOne::networkPing(IEEE_EUI64 address)
 
 	MO_LOG_TRACE(F("Waiting for response"));
 	// This is the ack message
-	MiraOneMessage* response = getNextMessage();
+	MiraOneMessage* response = getResponse();
 	if (!response || response->getMessageType() != MIRA_MESSAGE_TYPE_ACK)
 	{
 		delete response;
@@ -389,46 +649,948 @@ bool MiraOne::networkPing(IEEE_EUI64 address)
 //
 bool MiraOne::available()
 {
-	return _stream->available();
+	return _rxCount > 0 || _stream->available();
 }
 
-bool MiraOne::send(MiraOneMessage* message)
+MiraSendResult MiraOne::send(MiraOneMessage* message)
 {
-	message->setMessageIndex(_currentMessageId++);
-	message->dumpToLog(_logger);
-	return message->write(_stream, getNextMessageId(), _logger);
-	callWatchdog();
+	return send(message, MiraTxScheduler::getDefaultClass(message));
+}
+
+MiraSendResult MiraOne::send(MiraOneMessage* message, MiraTxClass txClass)
+{
+	return send(message, txClass, nullptr, nullptr);
+}
+
+MiraSendResult MiraOne::send(MiraOneMessage* message, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context)
+{
+	// The caller keeps ownership of message, a copy is queued and sent from update().
+	// For DATA_SEND the completion callback reports the outcome, other frames have none.
+	if (message->isDataSend() && _sendUsed >= _sendWindow)
+	{
+		MO_LOG_TRACE(F("send: Window full"));
+		return MiraSendResult::wouldBlock;
+	}
+	message->setMessageIndex(getNextMessageId());
+	return enqueue(new MiraOneMessage(*message), txClass, completioncallback, context);
+}
+
+MiraSendResult MiraOne::enqueue(MiraOneMessage* queued, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context)
+{
+	// Takes ownership of queued, the send window has been checked by the caller
+	if (!_scheduler.enqueue(queued, txClass))
+	{
+		delete queued;
+		MO_LOG_TRACE(F("send: Transmit queue full"));
+		return MiraSendResult::wouldBlock;
+	}
+	if (queued->isDataSend())
+	{
+		addInFlight(queued->getMessageIndex(), txClass, completioncallback, context);
+	}
+	return MiraSendResult::ok;
+}
+
+uint8_t MiraOne::getTxQueueCount()
+{
+	return _scheduler.getCount();
+}
+
+uint16_t MiraOne::getTxPendingCount()
+{
+	// Encoded bytes not yet handed to the stream
+	return _txRing.getCount();
+}
+
+uint32_t MiraOne::getUnmatchedResponseCount()
+{
+	// DATA_SEND responses that matched no frame in flight
+	return _unmatchedResponseCount;
+}
+
+uint32_t MiraOne::getRxCrcErrorCount()
+{
+	return _decoder.getCrcErrorCount();
+}
+
+uint32_t MiraOne::getRxResyncCount()
+{
+	return _decoder.getResyncCount();
+}
+
+bool MiraOne::sendRequest(MiraOneMessage* message, REQUEST_CALLBACK_SIGNATURE, void* context,
+	uint8_t replies, uint8_t replyType, const IEEE_EUI64* replyAddress)
+{
+	MiraRequest* request = findFreeRequest();
+	if (request == nullptr || send(message, MiraTxClass::control) != MiraSendResult::ok)
+	{
+		return false;
+	}
+	startRequest(request, message, requestcallback, context, replies, replyType, replyAddress);
+	return true;
+}
+
+bool MiraOne::cancelRequest(REQUEST_CALLBACK_SIGNATURE, void* context)
+{
+	// The callback is not called, late responses are handled as unsolicited frames
+	bool result = false;
+	for (uint16_t i = 0; i < MIRA_MAX_REQUESTS; i++)
+	{
+		MiraRequest* request = &_requests[i];
+		if (request->active && request->callback == requestcallback && request->context == context)
+		{
+			request->active = false;
+			result = true;
+		}
+	}
+	return result;
+}
+
+MiraRequest* MiraOne::findFreeRequest()
+{
+	for (uint16_t i = 0; i < MIRA_MAX_REQUESTS; i++)
+	{
+		if (!_requests[i].active)
+		{
+			return &_requests[i];
+		}
+	}
+	return nullptr;
+}
+
+void MiraOne::startRequest(MiraRequest* request, MiraOneMessage* message, REQUEST_CALLBACK_SIGNATURE, void* context,
+	uint8_t replies, uint8_t replyType, const IEEE_EUI64* replyAddress)
+{
+	// message has been given its index by send() or transmit()
+	request->callback = requestcallback;
+	request->context = context;
+	request->startedAt = millis();
+	request->deadline = request->startedAt + getEstimator(message->getMessageClass(), false)->getTimeout();
+	request->messageClass = message->getMessageClass();
+	request->messageIndex = message->getMessageIndex();
+	request->replyType = replyType;
+	request->replies = replies;
+	request->hasReplyAddress = replyAddress != nullptr;
+	if (replyAddress != nullptr)
+	{
+		request->replyAddress = *replyAddress;
+	}
+	request->acked = false;
+	request->active = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Flow control
+//
+void MiraOne::setSendWindow(uint8_t size)
+{
+	if (size < 1)
+	{
+		size = 1;
+	}
+	if (size > MIRA_MAX_SEND_WINDOW)
+	{
+		size = MIRA_MAX_SEND_WINDOW;
+	}
+	// Shrinking below the frames already outstanding just delays new sends until they are acked
+	_sendWindow = size;
+}
+
+uint8_t MiraOne::getSendWindow()
+{
+	return _sendWindow;
+}
+
+uint8_t MiraOne::getSendCredits()
+{
+	return _sendUsed >= _sendWindow ? 0 : _sendWindow - _sendUsed;
+}
+
+void MiraOne::setRetryLimit(uint8_t retries)
+{
+	_retryLimit = retries;
+}
+
+void MiraOne::setDeliveryCallback(DELIVERY_CALLBACK_SIGNATURE)
+{
+	this->deliverycallback = deliverycallback;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Timeouts
+//
+void MiraOne::setTimeoutLimits(MiraRttClass rttClass, uint32_t floor, uint32_t ceiling)
+{
+	_rtt[static_cast<uint8_t>(rttClass)].setLimits(floor, ceiling);
+}
+
+uint32_t MiraOne::getTimeout(MiraRttClass rttClass)
+{
+	return _rtt[static_cast<uint8_t>(rttClass)].getTimeout();
+}
+
+uint32_t MiraOne::getSmoothedRtt(MiraRttClass rttClass)
+{
+	return _rtt[static_cast<uint8_t>(rttClass)].getSmoothedRtt();
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Receiving
+//
 MiraOneMessage* MiraOne::getNextMessage()
 {
-	MiraOneMessage* result = new MiraOneMessage(MESSAGE_DATA_SEND);
-	if (result->read(_stream, _logger))
+	return waitForMessage(MIRA_SERIAL_TIMEOUT);
+}
+
+bool MiraOne::getNextMessage(MiraOneMessage* result)
+{
+	MiraOneMessage* message = getNextMessage();
+	if (message == nullptr)
 	{
-		result->dumpToLog(_logger);
+		return false;
+	}
+	result->takeFrom(message);
+	delete message;
+	return true;
+}
+
+MiraOneMessage* MiraOne::getQueuedMessage()
+{
+	// Non-blocking, only returns frames already read by update()
+	return dequeueReceived();
+}
+
+MiraOneMessage* MiraOne::peekQueuedMessage()
+{
+	// Next frame getQueuedMessage() returns, stays in the queue
+	return _rxHead;
+}
+
+bool MiraOne::transmit(MiraOneMessage* message)
+{
+	// Used by the blocking management calls, bypasses the queue as these are control frames.
+	// Goes out behind whatever is in the transmit ring, waits for room if the ring is full.
+	message->setMessageIndex(getNextMessageId());
+	uint32_t start = millis();
+	while (!encodeTx(message))
+	{
+		if (millis() - start > MIRA_SERIAL_TIMEOUT)
+		{
+			MO_LOG_ERROR(F("Transmit ring not drained, %u bytes pending"), _txRing.getCount());
+			_lastStatus = MiraStatus::sendFailure;
+			return false;
+		}
+		drainTx();
 		callWatchdog();
-		return result;
 	}
-	delete result;
+	drainTx();
+	callWatchdog();
+	_transmitAt = millis();
+	_transmitClass = message->getMessageClass();
+	_transmitIndex = message->getMessageIndex();
+	_awaitingAck = true;
+	_lastStatus = MiraStatus::ok;
+	return true;
+}
+
+MiraOneMessage* MiraOne::getResponse()
+{
+	// The first response after transmit() is the ACK and gives an RTT sample,
+	// later ones are replies waited for with the reply timeout of the class.
+	// An ERROR ends the command at once, callers see it as nullptr.
+	bool ack = _awaitingAck;
+	_awaitingAck = false;
+	MiraRttEstimator* estimator = getEstimator(_transmitClass, !ack);
+	MiraOneMessage* result = waitForMessage(estimator->getTimeout(), true, ack);
+	if (result == nullptr)
+	{
+		estimator->backOff();
+		_lastStatus = MiraStatus::timeout;
+		return nullptr;
+	}
+	if (ack)
+	{
+		estimator->addSample(millis() - _transmitAt);
+	}
+	if (result->isError())
+	{
+		_lastStatus = MiraStatus::error;
+		_lastErrorCode = result->getErrorCode();
+		MO_LOG_ERROR(F("Command class 0x%02x failed, error 0x%02x"), _transmitClass, _lastErrorCode);
+		delete result;
+		return nullptr;
+	}
+	_lastStatus = MiraStatus::ok;
+	return result;
+}
+
+MiraOneMessage* MiraOne::waitForMessage(uint32_t timeout, bool response, bool ack)
+{
+	// With response set only frames answering the last transmit() are taken, anything
+	// else stays queued for the application
+	// Make sure anything queued by send() is on the wire before waiting for a reply
+	serviceTxQueue();
+	uint32_t start = millis();
+	MiraOneMessage* result;
+	_waiting = true;
+	while (true)
+	{
+		drainTx();
+		serviceRx();
+		result = response ? dequeueResponse(ack) : dequeueReceived();
+		if (result != nullptr)
+		{
+			break;
+		}
+		if (millis() - start > timeout)
+		{
+			MO_LOG_ERROR(F("Timeout waiting for message"));
+			break;
+		}
+		delay(2);
+	}
+	_waiting = false;
 	callWatchdog();
+	return result;
+}
+
+MiraOneMessage* MiraOne::dequeueResponse(bool ack)
+{
+	// ACK and ERROR match on class and message index, as in matchRequest(), replies on
+	// class. Status frames for an earlier command of the class timed out and are dropped.
+	MiraOneMessage* previous = nullptr;
+	MiraOneMessage* message = _rxHead;
+	while (message != nullptr)
+	{
+		MiraOneMessage* next = message->_next;
+		uint8_t type = message->getMessageType();
+		bool status = type == MIRA_MESSAGE_TYPE_ACK || type == MIRA_MESSAGE_TYPE_ERROR;
+		bool match = false;
+		bool stale = false;
+		if (message->isResponse() && message->getMessageClass() == _transmitClass)
+		{
+			if (status)
+			{
+				match = ack && message->getMessageIndex() == _transmitIndex;
+				stale = !match;
+			}
+			else
+			{
+				match = !ack;
+			}
+		}
+		if (match || stale)
+		{
+			if (previous == nullptr)
+			{
+				_rxHead = next;
+			}
+			else
+			{
+				previous->_next = next;
+			}
+			if (_rxTail == message)
+			{
+				_rxTail = previous;
+			}
+			_rxCount--;
+			message->_next = nullptr;
+			if (match)
+			{
+				return message;
+			}
+			MO_LOG_DEBUG(F("Stale response 0x%02x dropped"), message->getMessageIndex());
+			delete message;
+		}
+		else
+		{
+			previous = message;
+		}
+		message = next;
+	}
 	return nullptr;
 }
 
-bool MiraOne::getNextMessage(MiraOneMessage* result)
+MiraRttEstimator* MiraOne::getEstimator(uint8_t messageClass, bool reply)
 {
-	if (result->read(_stream, _logger))
+	return &_rtt[static_cast<uint8_t>(MiraRttEstimator::getRttClass(messageClass, reply))];
+}
+
+void MiraOne::serviceReset()
+{
+	uint32_t now = millis();
+	switch (_resetState)
 	{
-		callWatchdog();
-#ifdef MIRA_DEBUG		
-		result->dumpToLog(_logger);
-#endif		
-		callWatchdog();
+		case MiraResetState::holding:
+			if (now - _resetAt < MIRA_RESET_PULSE)
+			{
+				return;
+			}
+			digitalWrite(_resetPin, HIGH);
+			// Whatever arrived while the module went down is discarded, and so is anything
+			// still to be written, the module would only see part of it
+			_txRing.clear();
+			_decoder.reset();
+			_rxPosition = 0;
+			_rxLength = 0;
+			while (_stream->available() > 0)
+			{
+				_stream->read();
+			}
+			_resetAt = now;
+			_resetState = MiraResetState::booting;
+			return;
+		case MiraResetState::booting:
+			// Give the module a chance to announce itself before probing
+			if (now - _resetAt >= MIRA_RESET_PROBE_DELAY)
+			{
+				_resetState = MiraResetState::probing;
+			}
+			break;
+		case MiraResetState::probing:
+			if (!_probeActive)
+			{
+				sendProbe();
+			}
+			break;
+		default:
+			return;
+	}
+	if (now - _resetAt > _resetMaxWait)
+	{
+		MO_LOG_ERROR(F("Module not ready after reset"));
+		_resetState = MiraResetState::failed;
+	}
+}
+
+void MiraOne::sendProbe()
+{
+	// Written directly, the transmit queue is held until the module is ready.
+	// The version reply fills the identity cache.
+	MiraRequest* request = findFreeRequest();
+	if (request == nullptr)
+	{
+		return;
+	}
+	MiraOneMessage* message = MiraOneMessage::getGetVersionMessage();
+	if (transmit(message))
+	{
+		_awaitingAck = false;
+		startRequest(request, message, onProbeResponse, this, 1);
+		_probeActive = true;
+	}
+	delete message;
+}
+
+void MiraOne::onProbeResponse(void* context, MiraOneMessage* response, bool done)
+{
+	MiraOne* self = static_cast<MiraOne*>(context);
+	if (response != nullptr &&
+		response->getMessageType() != MIRA_MESSAGE_TYPE_ACK &&
+		response->getMessageType() != MIRA_MESSAGE_TYPE_ERROR &&
+		response->getDataSize() >= 2)
+	{
+		self->_version.major = response->getData()[0];
+		self->_version.minor = response->getData()[1];
+		self->_hasVersion = true;
+	}
+	if (done)
+	{
+		self->_probeActive = false;
+	}
+}
+
+void MiraOne::serviceTxQueue()
+{
+	// Queued frames are encoded into the transmit ring while they fit, the ring is drained
+	// as far as the UART has room. A frame that does not fit stays queued for the next call.
+	drainTx();
+	if (!isReady() && _resetState != MiraResetState::failed)
+	{
+		return;
+	}
+	bool written = false;
+	MiraOneMessage* message;
+	while ((message = _scheduler.peek()) != nullptr)
+	{
+		if (written && !hasBudget())
+		{
+			break;
+		}
+		if (!encodeTx(message))
+		{
+			break;
+		}
+		message = _scheduler.dequeue();
+		if (!message->isDataSend() || !onDataSent(message->getMessageIndex(), message))
+		{
+			delete message;
+		}
+		written = true;
+	}
+	drainTx();
+}
+
+bool MiraOne::encodeTx(MiraOneMessage* message)
+{
+	// False if the frame does not fit behind what is already in the ring, any frame fits
+	// once the ring has drained
+	_txRing.beginFrame();
+	message->write(&_txRing, message->getMessageIndex(), _logger);
+	if (!_txRing.endFrame())
+	{
+		MO_LOG_TRACE(F("Transmit ring full, %u bytes pending"), _txRing.getCount());
+		return false;
+	}
+	message->dumpToLog(_logger);
+	return true;
+}
+
+void MiraOne::drainTx()
+{
+	// Never more than the stream can take without blocking. Streams that do not implement
+	// availableForWrite() always report 0, they get a few bytes per call to make progress.
+	if (_txRing.getCount() == 0)
+	{
+		return;
+	}
+	int room = _stream->availableForWrite();
+	if (room > 0)
+	{
+		_txRoomSeen = true;
+	}
+	else if (_txRoomSeen)
+	{
+		return;
+	}
+	else
+	{
+		room = MIRA_TX_MIN_DRAIN;
+	}
+	_txRing.drain(_stream, room);
+}
+
+void MiraOne::serviceRx()
+{
+	// Everything the stream has buffered is taken in one readBytes() call and decoded in
+	// place, each frame is handled as soon as it is complete
+	uint8_t frames = 0;
+	while (frames < MIRA_RX_QUEUE_SIZE && hasBudget())
+	{
+		if (_rxPosition == _rxLength)
+		{
+			int count = _stream->available();
+			if (count <= 0)
+			{
+				break;
+			}
+			if (count > MIRA_RX_SCRATCH_SIZE)
+			{
+				count = MIRA_RX_SCRATCH_SIZE;
+			}
+			_rxLength = _stream->readBytes(reinterpret_cast<char*>(_rxScratch), count);
+			_rxPosition = 0;
+			_lastRxAt = millis();
+			_rxReadAt = micros();
+		}
+		_rxPosition += _decoder.feed(&_rxScratch[_rxPosition], _rxLength - _rxPosition, _rxReadAt);
+		if (!_decoder.hasFrame())
+		{
+			continue;
+		}
+		// Frames handled here are read in place, only queued frames are copied
+		MiraFrameView frame(_decoder.getFrame(), _decoder.getFrameLength(), _decoder.getStartMicros(), _decoder.getEndMicros());
+		frames++;
+		recordTiming(frame);
+		if (_resetState == MiraResetState::booting || _resetState == MiraResetState::probing)
+		{
+			MO_LOG_DEBUG(F("Module ready after %lu ms"), (unsigned long)(millis() - _resetAt));
+			_resetState = MiraResetState::ready;
+		}
+		if (handleFrame(frame))
+		{
+			MO_LOG_TRACE(F("Frame 0x%02x/0x%02x handled"), frame.getMessageClass(), frame.getMessageType());
+			_decoder.consumeFrame();
+			continue;
+		}
+		MiraOneMessage* message = new MiraOneMessage();
+		message->setFrame(frame.getFrame(), frame.getLength());
+		message->setRxTime(frame.getStartMicros(), frame.getEndMicros());
+		_decoder.consumeFrame();
+		message->dumpToLog(_logger);
+		queueReceived(message);
+	}
+	if (_decoder.isInFrame() && _rxPosition == _rxLength && millis() - _lastRxAt > MIRA_SERIAL_TIMEOUT)
+	{
+		// The rest of this frame is never coming
+		MO_LOG_ERROR(F("Timeout in frame, dropped"));
+		_decoder.reset();
+	}
+}
+
+bool MiraOne::handleFrame(const MiraFrameView& frame)
+{
+	// Responses to DATA_SEND complete or retry the frame they answer
+	uint8_t type = frame.getMessageType();
+	bool status = type == MIRA_MESSAGE_TYPE_ACK || type == MIRA_MESSAGE_TYPE_ERROR;
+	if (frame.isResponse() && status && frame.getMessageClass() == MIRA_MESSAGE_CLASS_DATAMESSAGE)
+	{
+		onDataResponse(frame.getMessageIndex(), type == MIRA_MESSAGE_TYPE_ACK);
 		return true;
 	}
-	callWatchdog();
+	if (_waiting && status && frame.isResponse() &&
+		frame.getMessageClass() == _transmitClass && frame.getMessageIndex() == _transmitIndex)
+	{
+		// Answers the blocking command, taken by dequeueResponse() on the same index
+		return false;
+	}
+	MiraRequest* request = matchRequest(frame);
+	if (request != nullptr)
+	{
+		uint32_t now = millis();
+		bool reply = type != MIRA_MESSAGE_TYPE_ACK && type != MIRA_MESSAGE_TYPE_ERROR;
+		getEstimator(request->messageClass, reply)->addSample(now - request->startedAt);
+		bool done;
+		switch (type)
+		{
+			case MIRA_MESSAGE_TYPE_ERROR:
+				done = true;
+				break;
+			case MIRA_MESSAGE_TYPE_ACK:
+				request->acked = true;
+				done = request->replies == 0;
+				break;
+			default:
+				request->replies--;
+				done = request->replies == 0;
+				break;
+		}
+		if (!done)
+		{
+			// Wait for the next reply
+			request->startedAt = now;
+			request->deadline = now + getEstimator(request->messageClass, true)->getTimeout();
+		}
+		// Request callbacks take a message, only these frames are copied
+		MiraOneMessage response;
+		response.setFrame(frame.getFrame(), frame.getLength());
+		response.setRxTime(frame.getStartMicros(), frame.getEndMicros());
+		completeRequest(request, &response, done);
+		return true;
+	}
+	if (_duplicateFilter != nullptr && isDuplicateData(frame))
+	{
+		MO_LOG_DEBUG(F("Duplicate data dropped"));
+		return true;
+	}
+	if (_waiting && status)
+	{
+		// A blocking call is waiting for this
+		return false;
+	}
+	return _dispatcher.dispatch(frame);
+}
+
+void MiraOne::recordTiming(const MiraFrameView& frame)
+{
+	_rxFrameTime.add(frame.getEndMicros() - frame.getStartMicros());
+	_rxQueueTime.add(micros() - frame.getEndMicros());
+	if (frame.getMessageClass() != MIRA_MESSAGE_CLASS_DATAMESSAGE ||
+		(frame.getMessageType() != MIRA_MESSAGE_TYPE_DATA_RECEIVED &&
+		 frame.getMessageType() != MIRA_MESSAGE_TYPE_SLEEPY_DATA_RECEIVED) ||
+		frame.getDataSize() < sizeof(MiraOnePayloadv4) ||
+		frame.getData()[0] != 4)
+	{
+		return;
+	}
+	// Nodes ahead of the gateway clock would give negative times, those are left out
+	const MiraOnePayloadv4* payload = reinterpret_cast<const MiraOnePayloadv4*>(frame.getData());
+	uint32_t oneWay = frame.getStartMicros() - payload->timestamp;
+	if ((int32_t)oneWay >= 0)
+	{
+		_oneWayTime.add(oneWay);
+	}
+}
+
+bool MiraOne::isDuplicateData(const MiraFrameView& frame)
+{
+	// Only v3 and v4 payloads carry a sequence number, everything else is passed on
+	if (frame.getMessageClass() != MIRA_MESSAGE_CLASS_DATAMESSAGE ||
+		(frame.getMessageType() != MIRA_MESSAGE_TYPE_DATA_RECEIVED &&
+		 frame.getMessageType() != MIRA_MESSAGE_TYPE_SLEEPY_DATA_RECEIVED) ||
+		frame.getDataSize() < sizeof(MiraOnePayloadv3) ||
+		(frame.getData()[0] != 3 && frame.getData()[0] != 4))
+	{
+		return false;
+	}
+	const MiraOnePayloadv3* payload = reinterpret_cast<const MiraOnePayloadv3*>(frame.getData());
+	return _duplicateFilter->isDuplicate(payload->miraAddress, payload->sequence);
+}
+
+void MiraOne::queueReceived(MiraOneMessage* message)
+{
+	if (_rxCount >= MIRA_RX_QUEUE_SIZE)
+	{
+		MO_LOG_ERROR(F("Receive queue full, frame dropped"));
+		delete message;
+		return;
+	}
+	message->_next = nullptr;
+	if (_rxTail == nullptr)
+	{
+		_rxHead = message;
+	}
+	else
+	{
+		_rxTail->_next = message;
+	}
+	_rxTail = message;
+	_rxCount++;
+}
+
+MiraOneMessage* MiraOne::dequeueReceived()
+{
+	MiraOneMessage* result = _rxHead;
+	if (result == nullptr)
+	{
+		return nullptr;
+	}
+	_rxHead = result->_next;
+	if (_rxHead == nullptr)
+	{
+		_rxTail = nullptr;
+	}
+	result->_next = nullptr;
+	_rxCount--;
+	return result;
+}
+
+bool MiraOne::addInFlight(uint8_t messageIndex, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context)
+{
+	for (uint8_t i = 0; i < MIRA_MAX_SEND_WINDOW; i++)
+	{
+		MiraInFlight* entry = &_inFlight[i];
+		if (entry->state == MiraInFlightState::idle)
+		{
+			entry->message = nullptr;
+			entry->messageIndex = messageIndex;
+			entry->retries = 0;
+			entry->txClass = txClass;
+			entry->callback = completioncallback;
+			entry->context = context;
+			entry->state = MiraInFlightState::queued;
+			_sendUsed++;
+			return true;
+		}
+	}
 	return false;
 }
 
+bool MiraOne::onDataSent(uint8_t messageIndex, MiraOneMessage* message)
+{
+	// Keeps the written frame until it is acknowledged, message is nullptr for frames that
+	// are not retransmitted. Returns false if the frame was already completed while it
+	// waited in the queue.
+	for (uint8_t i = 0; i < MIRA_MAX_SEND_WINDOW; i++)
+	{
+		MiraInFlight* entry = &_inFlight[i];
+		if (entry->state == MiraInFlightState::queued && entry->messageIndex == messageIndex)
+		{
+			entry->message = message;
+			entry->sentAt = millis();
+			entry->deadline = entry->sentAt + getEstimator(MIRA_MESSAGE_CLASS_DATAMESSAGE, false)->getTimeout();
+			entry->state = MiraInFlightState::waitingAck;
+			return true;
+		}
+	}
+	return false;
+}
+
+void MiraOne::onDataResponse(uint8_t messageIndex, bool acked)
+{
+	// Match on the message index only. A response matching no frame is late, for
+	// example the ACK to the first copy of a frame whose retransmission was already
+	// acknowledged, and must not complete another frame.
+	MiraInFlight* match = nullptr;
+	for (uint8_t i = 0; i < MIRA_MAX_SEND_WINDOW; i++)
+	{
+		MiraInFlight* entry = &_inFlight[i];
+		if (entry->state != MiraInFlightState::idle && entry->messageIndex == messageIndex)
+		{
+			match = entry;
+			break;
+		}
+	}
+	if (match == nullptr)
+	{
+		_unmatchedResponseCount++;
+		MO_LOG_DEBUG(F("Unexpected data response 0x%02x dropped"), messageIndex);
+		return;
+	}
+	if (match->state == MiraInFlightState::waitingAck && match->retries == 0)
+	{
+		// Only frames sent once give a sample, an ACK to a retransmission is ambiguous
+		getEstimator(MIRA_MESSAGE_CLASS_DATAMESSAGE, false)->addSample(millis() - match->sentAt);
+	}
+	if (acked)
+	{
+		finishInFlight(match, true);
+	}
+	else if (match->state == MiraInFlightState::waitingAck)
+	{
+		MO_LOG_DEBUG(F("Data send 0x%02x rejected"), match->messageIndex);
+		scheduleRetry(match);
+	}
+}
+
+void MiraOne::scheduleRetry(MiraInFlight* entry)
+{
+	// Frames written while retries were off are not kept and cannot be sent again
+	if (entry->retries >= _retryLimit || entry->message == nullptr)
+	{
+		MO_LOG_ERROR(F("Data send 0x%02x failed"), entry->messageIndex);
+		finishInFlight(entry, false);
+		return;
+	}
+	// Capped exponential backoff with equal jitter, so nodes that collided do not retry in step
+	uint32_t backoff = MIRA_RETRY_BACKOFF_BASE;
+	for (uint8_t i = 0; i < entry->retries && backoff < MIRA_RETRY_BACKOFF_MAX; i++)
+	{
+		backoff <<= 1;
+	}
+	if (backoff > MIRA_RETRY_BACKOFF_MAX)
+	{
+		backoff = MIRA_RETRY_BACKOFF_MAX;
+	}
+	entry->retries++;
+	entry->deadline = millis() + backoff / 2 + random(backoff / 2 + 1);
+	entry->state = MiraInFlightState::backoff;
+}
+
+void MiraOne::finishInFlight(MiraInFlight* entry, bool delivered)
+{
+	// A frame still in the queue is deleted by serviceTxQueue() once written
+	if (entry->message != nullptr)
+	{
+		delete entry->message;
+		entry->message = nullptr;
+	}
+	entry->state = MiraInFlightState::idle;
+	if (_sendUsed > 0)
+	{
+		_sendUsed--;
+	}
+	if (deliverycallback != nullptr)
+	{
+		(deliverycallback)(entry->messageIndex, delivered);
+	}
+	if (entry->callback != nullptr)
+	{
+		(entry->callback)(entry->context, delivered);
+	}
+}
+
+void MiraOne::serviceRetransmissions()
+{
+	uint32_t now = millis();
+	for (uint8_t i = 0; i < MIRA_MAX_SEND_WINDOW; i++)
+	{
+		MiraInFlight* entry = &_inFlight[i];
+		if ((int32_t)(now - entry->deadline) < 0)
+		{
+			continue;
+		}
+		switch (entry->state)
+		{
+			case MiraInFlightState::waitingAck:
+				MO_LOG_DEBUG(F("No ACK for message 0x%02x"), entry->messageIndex);
+				getEstimator(MIRA_MESSAGE_CLASS_DATAMESSAGE, false)->backOff();
+				scheduleRetry(entry);
+				break;
+			case MiraInFlightState::backoff:
+				// Retransmissions keep their message index, so a late ACK still matches
+				if (_scheduler.enqueue(entry->message, entry->txClass))
+				{
+					entry->message = nullptr;
+					entry->state = MiraInFlightState::queued;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+MiraRequest* MiraOne::matchRequest(const MiraFrameView& frame)
+{
+	// ACK and ERROR match on message index only, anything else answers a blocking
+	// command or a request that is already gone. Replies go to the oldest request
+	// expecting that reply type and, when both sides have one, the same EUI64 address.
+	uint8_t type = frame.getMessageType();
+	bool status = type == MIRA_MESSAGE_TYPE_ACK || type == MIRA_MESSAGE_TYPE_ERROR;
+	IEEE_EUI64 address;
+	bool hasAddress = frame.getEUI64Address(address);
+	MiraRequest* match = nullptr;
+	for (uint16_t i = 0; i < MIRA_MAX_REQUESTS; i++)
+	{
+		MiraRequest* request = &_requests[i];
+		if (!request->active || request->messageClass != frame.getMessageClass())
+		{
+			continue;
+		}
+		if (status)
+		{
+			if (!request->acked && request->messageIndex == frame.getMessageIndex())
+			{
+				return request;
+			}
+			continue;
+		}
+		if (request->replies == 0 ||
+			(request->replyType != 0 && request->replyType != type) ||
+			(request->hasReplyAddress && hasAddress && memcmp(&request->replyAddress, &address, sizeof(IEEE_EUI64)) != 0))
+		{
+			continue;
+		}
+		if (match == nullptr || (int32_t)(request->startedAt - match->startedAt) < 0)
+		{
+			match = request;
+		}
+	}
+	return match;
+}
+
+void MiraOne::completeRequest(MiraRequest* request, MiraOneMessage* response, bool done)
+{
+	// Released before the callback, so the callback may issue a new request
+	if (done)
+	{
+		request->active = false;
+	}
+	if (request->callback != nullptr)
+	{
+		(request->callback)(request->context, response, done);
+	}
+}
+
+void MiraOne::serviceRequests()
+{
+	uint32_t now = millis();
+	for (uint16_t i = 0; i < MIRA_MAX_REQUESTS; i++)
+	{
+		MiraRequest* request = &_requests[i];
+		if (request->active && (int32_t)(now - request->deadline) >= 0)
+		{
+			MO_LOG_DEBUG(F("Request 0x%02x timed out"), request->messageIndex);
+			getEstimator(request->messageClass, request->acked)->backOff();
+			completeRequest(request, nullptr, true);
+		}
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Watchdog
@@ -19,6 +19,16 @@
 #include <Stream.h>
 #include <M2M_Logger.h>
 #include "M2M_MiraOneMessage.h"
+#include "M2M_MiraOneScheduler.h"
+#include "M2M_MiraOneDedup.h"
+#include "M2M_MiraOnePayload.h"
+#include "M2M_MiraOneAsync.h"
+#include "M2M_MiraOneDecoder.h"
+#include "M2M_MiraOneRtt.h"
+#include "M2M_MiraOneDispatch.h"
+#include "M2M_MiraOneFrame.h"
+#include "M2M_MiraOneHistogram.h"
+#include "M2M_MiraOneTxRing.h"
 
 #define M2M_MIRA_NETWORK_ID   42
 #define M2M_MIRA_AES_KEY   "o#VDMJhtp0N2ZY&s"
@@ -37,6 +47,45 @@
 //
 #define MIRA_BUFFER_SIZE	128
 
+#ifndef MIRA_SEND_WINDOW
+#define MIRA_SEND_WINDOW		4		// Default number of unacknowledged DATA_SEND frames
+#endif
+#define MIRA_MAX_SEND_WINDOW	16
+
+#ifndef MIRA_RX_SCRATCH_SIZE
+#ifdef MIRA_HOST_BUILD
+#define MIRA_RX_SCRATCH_SIZE	512		// Bytes taken from the stream per readBytes() call
+#else
+#define MIRA_RX_SCRATCH_SIZE	32
+#endif
+#endif
+
+#define MIRA_TX_MIN_DRAIN		16		// Bytes per update() for streams without availableForWrite()
+
+#ifndef MIRA_RX_QUEUE_SIZE
+#define MIRA_RX_QUEUE_SIZE		8		// Received frames held for getNextMessage()
+#endif
+
+#ifndef MIRA_RETRY_LIMIT
+#define MIRA_RETRY_LIMIT		3		// Retransmissions before a DATA_SEND is reported failed
+#endif
+#define MIRA_RETRY_BACKOFF_BASE	50		// ms, doubled for each retry
+#define MIRA_RETRY_BACKOFF_MAX	2000	// ms
+
+#define MIRA_RESET_PULSE		200		// ms the reset pin is held low
+#define MIRA_RESET_PROBE_DELAY	20		// ms after release before the module is probed
+#ifndef MIRA_RESET_MAX_WAIT
+#define MIRA_RESET_MAX_WAIT		2000	// ms after release for the module to become ready
+#endif
+
+#ifndef MIRA_MAX_REQUESTS
+#ifdef MIRA_HOST_BUILD
+#define MIRA_MAX_REQUESTS		128		// Outstanding request/response commands
+#else
+#define MIRA_MAX_REQUESTS		4
+#endif
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Logging defines
@@ -61,29 +110,127 @@
 #define MO_LOG_TRACE_END(...)
 #endif
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraSendResult: uint8_t
+{
+	ok = 0,
+	wouldBlock = 1,
+	failed = 2
+};
+
+enum class MiraInFlightState: uint8_t
+{
+	idle = 0,
+	queued = 1,			// Waiting in the transmit queue
+	waitingAck = 2,		// Written, waiting for the module to acknowledge
+	backoff = 3			// Not acknowledged, waiting to be retransmitted
+};
+
+enum class MiraStatus: uint8_t
+{
+	ok = 0,
+	error = 1,			// ERROR response, see getLastErrorCode()
+	timeout = 2,
+	sendFailure = 3,
+	invalidReply = 4	// Reply too short for the command
+};
+
+enum class MiraResetState: uint8_t
+{
+	idle = 0,			// Not reset since construction
+	holding = 1,		// Reset pin held low
+	booting = 2,		// Released, waiting for a frame from the module
+	probing = 3,		// Sending probe commands
+	ready = 4,
+	failed = 5			// No answer within the maximum wait
+};
+
+struct MiraInFlight
+{
+	MiraOneMessage* message;
+	uint32_t sentAt;
+	uint32_t deadline;
+	uint8_t messageIndex;
+	uint8_t retries;
+	MiraInFlightState state;
+	MiraTxClass txClass;
+	void (*callback)(void* context, bool delivered);
+	void* context;
+};
+
+struct MiraRequest
+{
+	void (*callback)(void* context, MiraOneMessage* response, bool done);
+	void* context;
+	uint32_t startedAt;		// Sent, or the last response received
+	uint32_t deadline;
+	IEEE_EUI64 replyAddress;
+	uint8_t messageClass;
+	uint8_t messageIndex;
+	uint8_t replyType;		// 0 matches any reply of the message class
+	uint8_t replies;		// Replies still expected after the ACK
+	bool hasReplyAddress;
+	bool acked;
+	bool active;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Class definitions
 //
 #define WATCHDOG_CALLBACK_SIGNATURE void (*watchdogcallback)()
+#define DELIVERY_CALLBACK_SIGNATURE void (*deliverycallback)(uint8_t messageIndex, bool delivered)
+#define COMPLETION_CALLBACK_SIGNATURE void (*completioncallback)(void* context, bool delivered)
+#define REQUEST_CALLBACK_SIGNATURE void (*requestcallback)(void* context, MiraOneMessage* response, bool done)
 
 class MiraOne
 {
 public:
-	// Constructor
+	// Constructor/Destructor
 	MiraOne(Stream& port, uint8_t resetPin = NOT_A_PIN, MiraAntenna antenna = MiraAntenna::internal);
+	~MiraOne();
 
 	// Infrastructure
 	void begin(bool root, const char* name, uint16_t networkId = M2M_MIRA_NETWORK_ID, const char* aesKey = M2M_MIRA_AES_KEY);
 	void update();
+	bool update(uint32_t budgetMicros);
 	uint8_t getNextMessageId();
 	IEEE_EUI64 getAddress();
 	void flush();
 	void reset();
+	void beginReset(uint32_t maxWait = MIRA_RESET_MAX_WAIT);
+	MiraResetState getResetState();
+	bool isReady();
 
 	// Logging
 	void setLogger(Logger* logger);
 
+	// Duplicate suppression
+	void setDuplicateFilter(MiraDuplicateFilter* filter);
+
+	// Frame handlers, called from update() for received frames not consumed by the library.
+	// Frames with a handler are not queued for getNextMessage().
+	bool setFrameHandler(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context);
+	bool setFrameHandler(uint8_t messageClass, FRAME_HANDLER_SIGNATURE, void* context);
+	template<typename FrameT, void (*Handler)(void* context, const FrameT& frame)>
+	bool setFrameHandler(void* context);
+
+	// Receive filtering, unsubscribed frames are dropped by the decoder after the header
+	void setSubscription(uint8_t messageClass, uint8_t messageType, bool subscribed);
+	void setSubscription(uint8_t messageClass, bool subscribed);
+	uint32_t getRxFilteredCount();
+
+	// Receive timing, in microseconds. Frame time is from the STC to the last byte, queue
+	// time from the last byte to when update() handled the frame, and one-way time from the
+	// send timestamp of a v4 payload to the STC.
+	void setRxByteTime(uint16_t micros);
+	MiraHistogram& getRxFrameHistogram();
+	MiraHistogram& getRxQueueHistogram();
+	MiraHistogram& getOneWayHistogram();
+
 	// Management
 	bool setNetworkCredentials(const uint16_t networkId, const char* aesKey);
 	bool becomeNetworkRoot();
@@ -92,6 +239,9 @@ public:
 	bool commitSettings();
 	bool getVersion(VersionInfo& version);
 	bool getEUI64Info(IEEE_EUI64* buffer);
+	bool refreshIdentity();
+	MiraStatus getLastStatus();
+	uint8_t getLastErrorCode();
 
 	// Network statistics
 	bool getNetworkStatistics(uint8_t interval);
@@ -99,17 +249,93 @@ public:
 
 	// Messaging
 	bool available();
-	bool send(MiraOneMessage* message);
+	MiraSendResult send(MiraOneMessage* message);
+	MiraSendResult send(MiraOneMessage* message, MiraTxClass txClass);
+	MiraSendResult send(MiraOneMessage* message, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context);
+	template<typename FrameT>
+	MiraSendResult sendFrame(const FrameT& frame, MiraTxClass txClass,
+		COMPLETION_CALLBACK_SIGNATURE = nullptr, void* context = nullptr);
+	uint8_t getTxQueueCount();
+	uint16_t getTxPendingCount();
+	uint32_t getUnmatchedResponseCount();
+	uint32_t getRxCrcErrorCount();
+	uint32_t getRxResyncCount();
+
+	// Request/response commands, the callback gets each matching response and nullptr on timeout
+	bool sendRequest(MiraOneMessage* message, REQUEST_CALLBACK_SIGNATURE, void* context,
+		uint8_t replies = 0, uint8_t replyType = 0, const IEEE_EUI64* replyAddress = nullptr);
+	bool cancelRequest(REQUEST_CALLBACK_SIGNATURE, void* context);
+
+#ifdef MIRA_COROUTINES
+	// Coroutine API, resumed from update()
+	MiraVersionAwaiter getVersionAsync();
+	MiraPingAwaiter pingAsync(IEEE_EUI64 address);
+	MiraSendAwaiter sendAsync(MiraOneMessage* message);
+	MiraSendAwaiter sendAsync(MiraOneMessage* message, MiraTxClass txClass);
+	MiraExecutor& getExecutor();
+#endif
+
+	// Flow control
+	void setSendWindow(uint8_t size);
+	uint8_t getSendWindow();
+	uint8_t getSendCredits();
+	void setRetryLimit(uint8_t retries);
+	void setDeliveryCallback(DELIVERY_CALLBACK_SIGNATURE);
+
+	// Timeouts, adapted from the measured round trip time of each command class
+	void setTimeoutLimits(MiraRttClass rttClass, uint32_t floor, uint32_t ceiling);
+	uint32_t getTimeout(MiraRttClass rttClass);
+	uint32_t getSmoothedRtt(MiraRttClass rttClass);
+
+	// Receiving
 	MiraOneMessage* getNextMessage();
 	bool getNextMessage(MiraOneMessage* result);
+	MiraOneMessage* getQueuedMessage();
+	MiraOneMessage* peekQueuedMessage();
 
 	// Watchdog
 	void setWatchdogCallback(WATCHDOG_CALLBACK_SIGNATURE);
 
 protected:
     void callWatchdog();
+	bool hasBudget();
+	bool canEncodeNow();
+	bool transmit(MiraOneMessage* message);
+	void serviceReset();
+	void sendProbe();
+	static void onProbeResponse(void* context, MiraOneMessage* response, bool done);
+	bool queryVersion(VersionInfo& version);
+	bool queryEUI64(IEEE_EUI64& address);
+	MiraOneMessage* getResponse();
+	MiraOneMessage* waitForMessage(uint32_t timeout, bool response = false, bool ack = false);
+	MiraOneMessage* dequeueResponse(bool ack);
+	MiraRttEstimator* getEstimator(uint8_t messageClass, bool reply);
+	void serviceTxQueue();
+	bool encodeTx(MiraOneMessage* message);
+	void drainTx();
+	void serviceRx();
+	bool handleFrame(const MiraFrameView& frame);
+	void recordTiming(const MiraFrameView& frame);
+	bool isDuplicateData(const MiraFrameView& frame);
+	void queueReceived(MiraOneMessage* message);
+	MiraOneMessage* dequeueReceived();
+	MiraSendResult enqueue(MiraOneMessage* queued, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context);
+	bool addInFlight(uint8_t messageIndex, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context);
+	bool onDataSent(uint8_t messageIndex, MiraOneMessage* message);
+	void onDataResponse(uint8_t messageIndex, bool acked);
+	void scheduleRetry(MiraInFlight* entry);
+	void finishInFlight(MiraInFlight* entry, bool delivered);
+	void serviceRetransmissions();
+	MiraRequest* findFreeRequest();
+	void startRequest(MiraRequest* request, MiraOneMessage* message, REQUEST_CALLBACK_SIGNATURE, void* context,
+		uint8_t replies = 0, uint8_t replyType = 0, const IEEE_EUI64* replyAddress = nullptr);
+	MiraRequest* matchRequest(const MiraFrameView& frame);
+	void completeRequest(MiraRequest* request, MiraOneMessage* response, bool done);
+	void serviceRequests();
 
 	Logger* _logger = nullptr;
+	MiraDuplicateFilter* _duplicateFilter = nullptr;
+	MiraDispatcher _dispatcher;
 	Stream* _stream;
 	uint8_t _messageBuffer[255];
 	uint16_t _networkId;
@@ -119,7 +345,97 @@ protected:
 	MiraAntenna _antenna;
 	uint8_t _resetPin;
 	uint8_t _currentMessageId;
+	MiraTxScheduler _scheduler;
+	MiraTxRing _txRing;
+	bool _txRoomSeen;			// The stream has reported room, 0 then means the UART is full
+	MiraInFlight _inFlight[MIRA_MAX_SEND_WINDOW];
+	uint8_t _sendWindow;
+	uint8_t _sendUsed;
+	uint8_t _retryLimit;
+	uint32_t _unmatchedResponseCount;
+	MiraRequest _requests[MIRA_MAX_REQUESTS];
+	MiraRttEstimator _rtt[MIRA_RTT_CLASS_COUNT];
+	uint32_t _transmitAt;
+	uint8_t _transmitClass;
+	uint8_t _transmitIndex;
+	MiraStatus _lastStatus;
+	uint8_t _lastErrorCode;
+	bool _awaitingAck;
+#ifdef MIRA_COROUTINES
+	MiraExecutor _executor;
+#endif
+	MiraOneMessage* _rxHead;
+	MiraOneMessage* _rxTail;
+	uint8_t _rxCount;
+	MiraFrameDecoder _decoder;
+	uint8_t _rxScratch[MIRA_RX_SCRATCH_SIZE];
+	uint16_t _rxPosition;
+	uint16_t _rxLength;
+	uint32_t _lastRxAt;
+	uint32_t _rxReadAt;			// micros() when the scratch buffer was filled
+	MiraHistogram _rxFrameTime;
+	MiraHistogram _rxQueueTime;
+	MiraHistogram _oneWayTime;
+	VersionInfo _version;
+	IEEE_EUI64 _address;
+	bool _hasVersion;
+	bool _hasAddress;
+	MiraResetState _resetState;
+	uint32_t _resetAt;
+	uint32_t _resetMaxWait;
+	bool _probeActive;
+	uint32_t _budgetStart;
+	uint32_t _budget;			// Microseconds, 0 when not limited
+	bool _waiting;				// In a blocking wait, ACK and ERROR are not dispatched
 	WATCHDOG_CALLBACK_SIGNATURE;
+	DELIVERY_CALLBACK_SIGNATURE;
+
+#ifdef MIRA_COROUTINES
+	friend class MiraVersionAwaiter;
+#endif
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Template functions
+//
+template<typename FrameT, void (*Handler)(void* context, const FrameT& frame)>
+bool MiraOne::setFrameHandler(void* context)
+{
+	return setFrameHandler(FrameT::messageClass, FrameT::messageType, &MiraTypedHandler<FrameT, Handler>::call, context);
+}
+
+template<typename FrameT>
+MiraSendResult MiraOne::sendFrame(const FrameT& frame, MiraTxClass txClass, COMPLETION_CALLBACK_SIGNATURE, void* context)
+{
+	// The data send checks are resolved at compile time
+	const bool dataSend = FrameT::messageClass == MIRA_MESSAGE_CLASS_DATAMESSAGE &&
+		FrameT::messageType == MIRA_MESSAGE_TYPE_DATA_SEND && !FrameT::isResponse;
+	if (dataSend && _sendUsed >= _sendWindow)
+	{
+		return MiraSendResult::wouldBlock;
+	}
+	uint8_t messageIndex = getNextMessageId();
+	// Straight into the transmit ring when nothing is queued ahead, unless the frame is kept
+	// for retransmission
+	if ((!dataSend || _retryLimit == 0) && canEncodeNow())
+	{
+		_txRing.beginFrame();
+		frame.write(&_txRing, messageIndex);
+		if (_txRing.endFrame())
+		{
+			if (dataSend)
+			{
+				addInFlight(messageIndex, txClass, completioncallback, context);
+				onDataSent(messageIndex, nullptr);
+			}
+			drainTx();
+			return MiraSendResult::ok;
+		}
+	}
+	MiraOneMessage* queued = frame.toMessage();
+	queued->setMessageIndex(messageIndex);
+	return enqueue(queued, txClass, completioncallback, context);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOne.h"
+
+#ifdef MIRA_COROUTINES
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraExecutor
+//
+void MiraExecutor::post(std::coroutine_handle<> handle)
+{
+	_ready.push_back(handle);
+}
+
+void MiraExecutor::run()
+{
+	// Only runs what was ready on entry, coroutines posted while running wait for the next
+	// update() so a busy coroutine cannot starve the serial port
+	size_t count = _ready.size();
+	while (count-- > 0)
+	{
+		std::coroutine_handle<> handle = _ready.front();
+		_ready.pop_front();
+		handle.resume();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraVersionAwaiter
+//
+MiraVersionAwaiter::MiraVersionAwaiter(MiraOne* mira)
+{
+	_mira = mira;
+	_result.ok = false;
+	_result.version.major = 0;
+	_result.version.minor = 0;
+}
+
+bool MiraVersionAwaiter::await_ready()
+{
+	// A cached version completes without suspending
+	if (_mira->_hasVersion)
+	{
+		_result.version = _mira->_version;
+		_result.ok = true;
+	}
+	return _result.ok;
+}
+
+bool MiraVersionAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	_handle = handle;
+	MiraOneMessage* message = MiraOneMessage::getGetVersionMessage();
+	// The version follows the ACK as a separate reply
+	bool sent = _mira->sendRequest(message, onResponse, this, 1);
+	delete message;
+	return sent;
+}
+
+void MiraVersionAwaiter::onResponse(void* context, MiraOneMessage* response, bool done)
+{
+	MiraVersionAwaiter* self = static_cast<MiraVersionAwaiter*>(context);
+	if (response != nullptr &&
+		response->getMessageType() != MIRA_MESSAGE_TYPE_ACK &&
+		response->getMessageType() != MIRA_MESSAGE_TYPE_ERROR &&
+		response->getDataSize() >= 2)
+	{
+		self->_result.version.major = response->getData()[0];
+		self->_result.version.minor = response->getData()[1];
+		self->_result.ok = true;
+		self->_mira->_version = self->_result.version;
+		self->_mira->_hasVersion = true;
+	}
+	if (done)
+	{
+		self->_mira->getExecutor().post(self->_handle);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraPingAwaiter
+//
+MiraPingAwaiter::MiraPingAwaiter(MiraOne* mira, IEEE_EUI64 address)
+{
+	_mira = mira;
+	_address = address;
+	_result.ok = false;
+	_result.roundTrip = 0;
+}
+
+bool MiraPingAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	_handle = handle;
+	_start = millis();
+	MiraOneMessage* message = MiraOneMessage::getNetworkPingMessage(_address);
+	bool sent = _mira->sendRequest(message, onResponse, this, 1, MIRA_MESSAGE_TYPE_NETWORK_PONG, &_address);
+	delete message;
+	return sent;
+}
+
+void MiraPingAwaiter::onResponse(void* context, MiraOneMessage* response, bool done)
+{
+	MiraPingAwaiter* self = static_cast<MiraPingAwaiter*>(context);
+	if (response != nullptr && response->getMessageType() == MIRA_MESSAGE_TYPE_NETWORK_PONG)
+	{
+		self->_result.ok = true;
+		self->_result.roundTrip = millis() - self->_start;
+	}
+	if (done)
+	{
+		self->_mira->getExecutor().post(self->_handle);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraSendAwaiter
+//
+MiraSendAwaiter::MiraSendAwaiter(MiraOne* mira, MiraOneMessage* message, MiraTxClass txClass)
+{
+	_mira = mira;
+	_message = message;
+	_txClass = txClass;
+	_result = MiraSendResult::failed;
+}
+
+bool MiraSendAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	_handle = handle;
+	if (!_message->isDataSend())
+	{
+		// Other commands complete on their ACK
+		if (!_mira->sendRequest(_message, onResponse, this))
+		{
+			_result = MiraSendResult::wouldBlock;
+			return false;
+		}
+		return true;
+	}
+	_result = _mira->send(_message, _txClass, onDelivery, this);
+	return _result == MiraSendResult::ok;
+}
+
+void MiraSendAwaiter::onDelivery(void* context, bool delivered)
+{
+	MiraSendAwaiter* self = static_cast<MiraSendAwaiter*>(context);
+	self->_result = delivered ? MiraSendResult::ok : MiraSendResult::failed;
+	self->_mira->getExecutor().post(self->_handle);
+}
+
+void MiraSendAwaiter::onResponse(void* context, MiraOneMessage* response, bool done)
+{
+	MiraSendAwaiter* self = static_cast<MiraSendAwaiter*>(context);
+	if (!done)
+	{
+		return;
+	}
+	bool acked = response != nullptr && response->getMessageType() == MIRA_MESSAGE_TYPE_ACK;
+	self->_result = acked ? MiraSendResult::ok : MiraSendResult::failed;
+	self->_mira->getExecutor().post(self->_handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraOne coroutine API
+//
+MiraVersionAwaiter MiraOne::getVersionAsync()
+{
+	return MiraVersionAwaiter(this);
+}
+
+MiraPingAwaiter MiraOne::pingAsync(IEEE_EUI64 address)
+{
+	return MiraPingAwaiter(this, address);
+}
+
+MiraSendAwaiter MiraOne::sendAsync(MiraOneMessage* message)
+{
+	return MiraSendAwaiter(this, message, MiraTxScheduler::getDefaultClass(message));
+}
+
+MiraSendAwaiter MiraOne::sendAsync(MiraOneMessage* message, MiraTxClass txClass)
+{
+	return MiraSendAwaiter(this, message, txClass);
+}
+
+MiraExecutor& MiraOne::getExecutor()
+{
+	return _executor;
+}
+
+#endif
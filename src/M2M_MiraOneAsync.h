@@ -0,0 +1,155 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// C++20 coroutine API for host builds.
+//
+// The awaiters returned by MiraOne::getVersionAsync(), pingAsync() and sendAsync() send their
+// command when awaited and suspend the calling coroutine until the matching response, or a
+// timeout, has been handled. Resumption is deferred to the executor owned by the MiraOne
+// instance, which MiraOne::update() runs after servicing the serial port, so coroutines
+// never run from inside the frame handling code.
+//
+// Application coroutines return MiraTask. They start running immediately when called and
+// free themselves when they return:
+//
+//   MiraTask poll(MiraOne& mira)
+//   {
+//       MiraVersionResult result = co_await mira.getVersionAsync();
+//       ...
+//   }
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEASYNC_h__
+#define __M2M_MIRAONEASYNC_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneMessage.h"
+
+#if defined(MIRA_HOST_BUILD) && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define MIRA_COROUTINES
+#endif
+
+#ifdef MIRA_COROUTINES
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+
+class MiraOne;
+enum class MiraSendResult: uint8_t;
+enum class MiraTxClass: uint8_t;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+struct MiraVersionResult
+{
+	bool ok;
+	VersionInfo version;
+};
+
+struct MiraPingResult
+{
+	bool ok;
+	uint32_t roundTrip;		// ms, from the ping being queued to the pong
+};
+
+struct MiraTask
+{
+	struct promise_type
+	{
+		MiraTask get_return_object() { return MiraTask(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraExecutor
+{
+public:
+	void post(std::coroutine_handle<> handle);
+	void run();
+
+private:
+	std::deque<std::coroutine_handle<>> _ready;
+};
+
+class MiraVersionAwaiter
+{
+public:
+	MiraVersionAwaiter(MiraOne* mira);
+	MiraVersionAwaiter(const MiraVersionAwaiter&) = delete;
+
+	bool await_ready();
+	bool await_suspend(std::coroutine_handle<> handle);
+	MiraVersionResult await_resume() { return _result; }
+
+private:
+	MiraOne* _mira;
+	std::coroutine_handle<> _handle;
+	MiraVersionResult _result;
+
+	static void onResponse(void* context, MiraOneMessage* response, bool done);
+};
+
+class MiraPingAwaiter
+{
+public:
+	MiraPingAwaiter(MiraOne* mira, IEEE_EUI64 address);
+	MiraPingAwaiter(const MiraPingAwaiter&) = delete;
+
+	bool await_ready() { return false; }
+	bool await_suspend(std::coroutine_handle<> handle);
+	MiraPingResult await_resume() { return _result; }
+
+private:
+	MiraOne* _mira;
+	IEEE_EUI64 _address;
+	uint32_t _start = 0;
+	std::coroutine_handle<> _handle;
+	MiraPingResult _result;
+
+	static void onResponse(void* context, MiraOneMessage* response, bool done);
+};
+
+class MiraSendAwaiter
+{
+public:
+	MiraSendAwaiter(MiraOne* mira, MiraOneMessage* message, MiraTxClass txClass);
+	MiraSendAwaiter(const MiraSendAwaiter&) = delete;
+
+	bool await_ready() { return false; }
+	bool await_suspend(std::coroutine_handle<> handle);
+	MiraSendResult await_resume() { return _result; }
+
+private:
+	MiraOne* _mira;
+	MiraOneMessage* _message;
+	MiraTxClass _txClass;
+	std::coroutine_handle<> _handle;
+	MiraSendResult _result;
+
+	static void onDelivery(void* context, bool delivered);
+	static void onResponse(void* context, MiraOneMessage* response, bool done);
+};
+
+#endif
+
+#endif
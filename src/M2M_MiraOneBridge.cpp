@@ -0,0 +1,270 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneBridge.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraBridge::MiraBridge(MiraUplink& uplink)
+{
+	_uplink = &uplink;
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		_batches[i].state = MiraBatchState::free;
+		_batches[i].length = 0;
+		_batches[i].count = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Bridging
+//
+bool MiraBridge::add(uint8_t channel, const uint8_t* data, uint8_t length)
+{
+	uint16_t size = MIRA_BRIDGE_RECORD_HEADER + length;
+	MiraBridgeBatch* batch = findFilling(channel);
+	if (batch != nullptr && batch->length + size > MIRA_BRIDGE_BATCH_SIZE)
+	{
+		seal(batch);
+		batch = nullptr;
+	}
+	if (batch == nullptr)
+	{
+		batch = findFree();
+		if (batch == nullptr)
+		{
+			_refused++;
+			return false;
+		}
+		batch->channel = channel;
+		batch->openedAt = millis();
+		batch->length = 0;
+		batch->count = 0;
+		batch->attempts = 0;
+		batch->state = MiraBatchState::filling;
+	}
+	uint32_t age = millis() - batch->openedAt;
+	if (age > 0xffff)
+	{
+		age = 0xffff;
+	}
+	uint8_t* record = &batch->data[batch->length];
+	record[0] = length;
+	record[1] = static_cast<uint8_t>(age);
+	record[2] = static_cast<uint8_t>(age >> 8);
+	memcpy(&record[MIRA_BRIDGE_RECORD_HEADER], data, length);
+	batch->length += size;
+	batch->count++;
+	if (batch->length >= _flushSize)
+	{
+		seal(batch);
+	}
+	return true;
+}
+
+bool MiraBridge::canAccept(uint8_t channel, uint8_t length)
+{
+	MiraBridgeBatch* batch = findFilling(channel);
+	if (batch != nullptr && batch->length + MIRA_BRIDGE_RECORD_HEADER + length <= MIRA_BRIDGE_BATCH_SIZE)
+	{
+		return true;
+	}
+	return findFree() != nullptr;
+}
+
+void MiraBridge::update()
+{
+	uint32_t now = millis();
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		MiraBridgeBatch* batch = &_batches[i];
+		if (batch->state == MiraBatchState::filling && now - batch->openedAt >= _maxAge)
+		{
+			seal(batch);
+		}
+	}
+	if (_sending != nullptr)
+	{
+		switch (_uplink->poll())
+		{
+			case MiraUplinkStatus::busy:
+				return;
+			case MiraUplinkStatus::done:
+				_sent++;
+				_sending->state = MiraBatchState::free;
+				break;
+			case MiraUplinkStatus::failed:
+				// Kept for a later attempt, other batches wait behind it to keep the order
+				_failed++;
+				if (++_sending->attempts < MIRA_BRIDGE_RETRY_LIMIT)
+				{
+					_sending->state = MiraBatchState::sealed;
+					_retryAt = now + MIRA_BRIDGE_RETRY_DELAY;
+					_retryPending = true;
+					break;
+				}
+				_dropped++;
+				_sending->state = MiraBatchState::free;
+				break;
+			case MiraUplinkStatus::rejected:
+				_dropped++;
+				_sending->state = MiraBatchState::free;
+				break;
+		}
+		_sending = nullptr;
+	}
+	if (_retryPending)
+	{
+		// Only compared while a retry is pending, millis() wraps
+		if ((int32_t)(now - _retryAt) < 0)
+		{
+			return;
+		}
+		_retryPending = false;
+	}
+	MiraBridgeBatch* batch = findOldestSealed();
+	if (batch == nullptr)
+	{
+		return;
+	}
+	if (!_uplink->begin(*batch))
+	{
+		_failed++;
+		_retryAt = now + MIRA_BRIDGE_RETRY_DELAY;
+		_retryPending = true;
+		return;
+	}
+	batch->state = MiraBatchState::sending;
+	_sending = batch;
+}
+
+void MiraBridge::flush()
+{
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		if (_batches[i].state == MiraBatchState::filling)
+		{
+			seal(&_batches[i]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property setters
+//
+void MiraBridge::setMaxAge(uint32_t maxAge)
+{
+	_maxAge = maxAge;
+}
+
+void MiraBridge::setFlushSize(uint16_t size)
+{
+	_flushSize = size > MIRA_BRIDGE_BATCH_SIZE ? MIRA_BRIDGE_BATCH_SIZE : size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint8_t MiraBridge::getPendingCount()
+{
+	// Batches holding records, filling or waiting
+	uint8_t result = 0;
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		if (_batches[i].state != MiraBatchState::free)
+		{
+			result++;
+		}
+	}
+	return result;
+}
+
+uint32_t MiraBridge::getSentCount()
+{
+	return _sent;
+}
+
+uint32_t MiraBridge::getFailedCount()
+{
+	return _failed;
+}
+
+uint32_t MiraBridge::getDroppedCount()
+{
+	// Batches rejected by the uplink or failed MIRA_BRIDGE_RETRY_LIMIT times
+	return _dropped;
+}
+
+uint32_t MiraBridge::getRefusedCount()
+{
+	return _refused;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraBridgeBatch* MiraBridge::findFilling(uint8_t channel)
+{
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		if (_batches[i].state == MiraBatchState::filling && _batches[i].channel == channel)
+		{
+			return &_batches[i];
+		}
+	}
+	return nullptr;
+}
+
+MiraBridgeBatch* MiraBridge::findFree()
+{
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		if (_batches[i].state == MiraBatchState::free)
+		{
+			return &_batches[i];
+		}
+	}
+	return nullptr;
+}
+
+MiraBridgeBatch* MiraBridge::findOldestSealed()
+{
+	MiraBridgeBatch* result = nullptr;
+	for (uint8_t i = 0; i < MIRA_BRIDGE_BATCHES; i++)
+	{
+		MiraBridgeBatch* batch = &_batches[i];
+		if (batch->state == MiraBatchState::sealed &&
+			(result == nullptr || (int32_t)(batch->openedAt - result->openedAt) < 0))
+		{
+			result = batch;
+		}
+	}
+	return result;
+}
+
+void MiraBridge::seal(MiraBridgeBatch* batch)
+{
+	if (batch->count == 0)
+	{
+		batch->state = MiraBatchState::free;
+		return;
+	}
+	batch->state = MiraBatchState::sealed;
+}
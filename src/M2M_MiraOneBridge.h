@@ -0,0 +1,173 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Batching bridge from the radio side of a gateway to an uplink.
+//
+// Records received from nodes are appended to a batch per uplink channel. A batch is sealed
+// when it reaches the flush size or the oldest record in it reaches the maximum age, and
+// sealed batches are handed to the uplink one at a time, oldest first. A failed batch is kept
+// and retried up to MIRA_BRIDGE_RETRY_LIMIT times, a batch the uplink rejects is dropped at
+// once, so one batch the service never accepts does not hold up the ones behind it. Dropped
+// batches are counted by getDroppedCount(). Batches come from a fixed pool, when the uplink
+// falls behind and the pool is used up add() refuses new records, which the gateway should
+// treat as backpressure and leave frames in the MiraOne receive queue.
+//
+// Records are stored as a length byte, the age in ms relative to the batch as a 16-bit
+// little endian value, and the record bytes. MiraBridgeBatch::getRecord() walks them.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEBRIDGE_h__
+#define __M2M_MIRAONEBRIDGE_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_BRIDGE_BATCHES
+#ifdef MIRA_HOST_BUILD
+#define MIRA_BRIDGE_BATCHES			16		// Batches in the pool, filling and waiting
+#else
+#define MIRA_BRIDGE_BATCHES			3
+#endif
+#endif
+
+#ifndef MIRA_BRIDGE_BATCH_SIZE
+#ifdef MIRA_HOST_BUILD
+#define MIRA_BRIDGE_BATCH_SIZE		4096	// Bytes of records per batch
+#else
+#define MIRA_BRIDGE_BATCH_SIZE		512
+#endif
+#endif
+
+#define MIRA_BRIDGE_RECORD_HEADER	3		// Length and age
+#define MIRA_BRIDGE_MAX_AGE			5000	// ms, default
+#define MIRA_BRIDGE_RETRY_DELAY		2000	// ms between attempts for a failed batch
+
+#ifndef MIRA_BRIDGE_RETRY_LIMIT
+#define MIRA_BRIDGE_RETRY_LIMIT		5		// Failed sends before a batch is dropped
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraBatchState: uint8_t
+{
+	free = 0,
+	filling = 1,
+	sealed = 2,			// Waiting for the uplink
+	sending = 3
+};
+
+enum class MiraUplinkStatus: uint8_t
+{
+	busy = 0,
+	done = 1,
+	failed = 2,
+	rejected = 3		// Will not be accepted when sent again, the batch is dropped
+};
+
+struct MiraBridgeRecord
+{
+	const uint8_t* data;
+	uint16_t age;			// ms after the batch was opened
+	uint8_t length;
+};
+
+struct MiraBridgeBatch
+{
+	uint8_t data[MIRA_BRIDGE_BATCH_SIZE];
+	uint32_t openedAt;
+	uint16_t length;
+	uint16_t count;
+	uint8_t channel;
+	uint8_t attempts;		// Failed sends
+	MiraBatchState state;
+
+	bool getRecord(uint16_t& offset, MiraBridgeRecord& record) const
+	{
+		if (offset + MIRA_BRIDGE_RECORD_HEADER > length)
+		{
+			return false;
+		}
+		record.length = data[offset];
+		record.age = static_cast<uint16_t>(data[offset + 1] | data[offset + 2] << 8);
+		record.data = &data[offset + MIRA_BRIDGE_RECORD_HEADER];
+		offset += MIRA_BRIDGE_RECORD_HEADER + record.length;
+		return true;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraUplink
+{
+public:
+	virtual ~MiraUplink() {}
+
+	// Starts sending a batch, returns false if it could not be started. The batch stays
+	// valid until poll() returns done or failed.
+	virtual bool begin(const MiraBridgeBatch& batch) = 0;
+	virtual MiraUplinkStatus poll() = 0;
+};
+
+class MiraBridge
+{
+public:
+	// Constructor
+	MiraBridge(MiraUplink& uplink);
+
+	// Bridging
+	bool add(uint8_t channel, const uint8_t* data, uint8_t length);
+	bool canAccept(uint8_t channel, uint8_t length);
+	void update();
+	void flush();
+
+	// Property setters
+	void setMaxAge(uint32_t maxAge);
+	void setFlushSize(uint16_t size);
+
+	// Property getters
+	uint8_t getPendingCount();
+	uint32_t getSentCount();
+	uint32_t getFailedCount();
+	uint32_t getDroppedCount();
+	uint32_t getRefusedCount();
+
+private:
+	MiraUplink* _uplink;
+	MiraBridgeBatch _batches[MIRA_BRIDGE_BATCHES];
+	MiraBridgeBatch* _sending = nullptr;
+	uint32_t _maxAge = MIRA_BRIDGE_MAX_AGE;
+	uint16_t _flushSize = MIRA_BRIDGE_BATCH_SIZE;
+	uint32_t _retryAt = 0;
+	bool _retryPending = false;
+	uint32_t _sent = 0;
+	uint32_t _failed = 0;
+	uint32_t _dropped = 0;
+	uint32_t _refused = 0;
+
+	// Private functions
+	MiraBridgeBatch* findFilling(uint8_t channel);
+	MiraBridgeBatch* findFree();
+	MiraBridgeBatch* findOldestSealed();
+	void seal(MiraBridgeBatch* batch);
+};
+
+#endif
@@ -0,0 +1,284 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneDecoder.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraFrameDecoder::MiraFrameDecoder()
+{
+	for (uint8_t i = 0; i < MIRA_DECODER_CLASSES; i++)
+	{
+		_subscriptions[i] = 0xffff;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Decoding
+//
+size_t MiraFrameDecoder::feed(const uint8_t* data, size_t length)
+{
+	return feed(data, length, micros());
+}
+
+size_t MiraFrameDecoder::feed(const uint8_t* data, size_t length, uint32_t timestamp)
+{
+	// timestamp is when the last byte of data was read
+	size_t position = 0;
+	while (position < length && !_complete)
+	{
+		if (!_inFrame)
+		{
+			const uint8_t* start = static_cast<const uint8_t*>(memchr(data + position, MIRA_CHAR_STC, length - position));
+			if (start == nullptr)
+			{
+				return length;
+			}
+			position = start - data + 1;
+			_startMicros = getByteTime(timestamp, length - position);
+			_inFrame = true;
+			_escape = false;
+			_skip = false;
+			_length = 0;
+			_expected = 0;
+			continue;
+		}
+		if (_escape)
+		{
+			if (data[position] == MIRA_CHAR_STC)
+			{
+				resync();
+				position++;
+				_startMicros = getByteTime(timestamp, length - position);
+				continue;
+			}
+			if (!_skip)
+			{
+				_buffer[_length] = ~data[position];
+			}
+			_length++;
+			position++;
+			_escape = false;
+		}
+		else
+		{
+			// Copy the run up to the next special character, or as much as the frame needs
+			size_t run = length - position;
+			uint16_t needed = getNeeded();
+			if (run > needed)
+			{
+				run = needed;
+			}
+			size_t plain = MiraOneMessage::findSpecial(data + position, run);
+			if (!_skip)
+			{
+				memcpy(&_buffer[_length], data + position, plain);
+			}
+			_length += plain;
+			position += plain;
+			if (plain < run)
+			{
+				uint8_t ch = data[position++];
+				if (ch == MIRA_CHAR_ESC)
+				{
+					_escape = true;
+					continue;
+				}
+				// An unescaped STC always starts a frame, the current one lost bytes
+				resync();
+				_startMicros = getByteTime(timestamp, length - position);
+				continue;
+			}
+		}
+		if (getNeeded() == 0)
+		{
+			// On a CRC failure the hunt for the next STC continues from the following byte
+			_inFrame = false;
+			_endMicros = getByteTime(timestamp, length - position);
+			if (_skip)
+			{
+				_filtered++;
+				consumeFrame();
+				continue;
+			}
+			_complete = checkFrame();
+		}
+	}
+	return position;
+}
+
+bool MiraFrameDecoder::hasFrame()
+{
+	return _complete;
+}
+
+bool MiraFrameDecoder::isInFrame()
+{
+	return _inFrame;
+}
+
+void MiraFrameDecoder::consumeFrame()
+{
+	_complete = false;
+	_skip = false;
+	_length = 0;
+	_expected = 0;
+}
+
+void MiraFrameDecoder::reset()
+{
+	_inFrame = false;
+	_escape = false;
+	consumeFrame();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Filtering
+//
+void MiraFrameDecoder::setSubscription(uint8_t messageClass, uint16_t typeMask)
+{
+	if (messageClass < MIRA_DECODER_CLASSES)
+	{
+		_subscriptions[messageClass] = typeMask;
+	}
+}
+
+uint16_t MiraFrameDecoder::getSubscription(uint8_t messageClass)
+{
+	return messageClass < MIRA_DECODER_CLASSES ? _subscriptions[messageClass] : 0;
+}
+
+bool MiraFrameDecoder::isSubscribed(uint8_t messageClass, uint8_t messageType)
+{
+	// Types outside the mask cannot be filtered
+	if (messageType >= 16)
+	{
+		return true;
+	}
+	return (_subscriptions[messageClass & 0x0f] & (1 << messageType)) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property setters
+//
+void MiraFrameDecoder::setByteTime(uint16_t micros)
+{
+	// 10000000 / baud rate for 8N1, 0 dates all bytes of a block to when it was read
+	_byteTime = micros;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+const uint8_t* MiraFrameDecoder::getFrame()
+{
+	return _buffer;
+}
+
+uint16_t MiraFrameDecoder::getFrameLength()
+{
+	// Excluding the CRC
+	return _complete ? _length - 2 : 0;
+}
+
+uint32_t MiraFrameDecoder::getStartMicros()
+{
+	return _startMicros;
+}
+
+uint32_t MiraFrameDecoder::getEndMicros()
+{
+	return _endMicros;
+}
+
+uint32_t MiraFrameDecoder::getCrcErrorCount()
+{
+	return _crcErrors;
+}
+
+uint32_t MiraFrameDecoder::getResyncCount()
+{
+	return _resyncs;
+}
+
+uint32_t MiraFrameDecoder::getFilteredCount()
+{
+	return _filtered;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+uint16_t MiraFrameDecoder::getNeeded()
+{
+	if (_expected != 0)
+	{
+		return _expected - _length;
+	}
+	// Header, type, index and size come first
+	if (_length < 4)
+	{
+		return 4 - _length;
+	}
+	uint16_t addressSize = 0;
+	if (_buffer[0] & MIRA_MESSAGE_ADDRESS_FLAG)
+	{
+		// The addressing byte tells if an EUI64 follows
+		if (_length < 5)
+		{
+			return 1;
+		}
+		addressSize = (_buffer[4] & 0b00001111) == MIRA_ADDRESS_TYPE_EUI64 ? 9 : 1;
+	}
+	_expected = 4 + addressSize + _buffer[3] + 2;
+	// The header is complete, the rest of an unwanted frame is only counted
+	_skip = !isSubscribed(_buffer[0], _buffer[1]);
+	return _expected - _length;
+}
+
+uint32_t MiraFrameDecoder::getByteTime(uint32_t timestamp, size_t following)
+{
+	// Arrival of the byte before position, with following bytes after it in the block
+	return timestamp - static_cast<uint32_t>(following) * _byteTime;
+}
+
+void MiraFrameDecoder::resync()
+{
+	_resyncs++;
+	_escape = false;
+	_skip = false;
+	_length = 0;
+	_expected = 0;
+}
+
+bool MiraFrameDecoder::checkFrame()
+{
+	uint16_t crc = MiraOneMessage::updateCrc(0, _buffer, _length - 2);
+	uint16_t received = static_cast<uint16_t>(_buffer[_length - 2] << 8 | _buffer[_length - 1]);
+	if (crc != received)
+	{
+		_crcErrors++;
+		_length = 0;
+		_expected = 0;
+		return false;
+	}
+	return true;
+}
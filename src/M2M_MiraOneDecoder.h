@@ -0,0 +1,107 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Incremental frame decoder.
+//
+// Bytes are fed in blocks of any size. Between special characters the decoder copies whole
+// runs into the frame buffer, locating the next STC or ESC with MiraOneMessage::findSpecial,
+// and the CRC is calculated over the complete frame once all bytes have arrived.
+//
+// feed() stops after the last byte of a frame, the caller handles the frame, calls
+// consumeFrame() and feeds the remaining bytes.
+//
+// An unescaped STC can never be part of a frame, so one seen inside a frame means bytes were
+// lost and the decoder restarts on it. After a CRC failure decoding resumes at the byte
+// following the bad frame. Either way a corrupted byte costs at most the frame it is in.
+//
+// Frames can be filtered by class and type. Once the header of an unsubscribed frame is in,
+// the rest is only counted to find its end, it is neither stored nor CRC checked.
+//
+// Each frame gets the micros() time its STC and its last byte arrived. feed() is given the
+// time the block was read, and with a byte time set, bytes earlier in the block are dated
+// back one byte time each, as they arrived back to back at the line rate at the latest.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEDECODER_h__
+#define __M2M_MIRAONEDECODER_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_MAX_FRAME_SIZE		270		// Header 4, address 9, data 255, CRC 2, unescaped
+#define MIRA_DECODER_CLASSES	16		// Subscription masks, one bit per message type
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraFrameDecoder
+{
+public:
+	// Constructor
+	MiraFrameDecoder();
+
+	// Decoding
+	size_t feed(const uint8_t* data, size_t length);
+	size_t feed(const uint8_t* data, size_t length, uint32_t timestamp);
+	bool hasFrame();
+	bool isInFrame();
+	void consumeFrame();
+	void reset();
+
+	// Filtering, all frames are subscribed by default
+	void setSubscription(uint8_t messageClass, uint16_t typeMask);
+	uint16_t getSubscription(uint8_t messageClass);
+	bool isSubscribed(uint8_t messageClass, uint8_t messageType);
+
+	// Property setters
+	void setByteTime(uint16_t micros);
+
+	// Property getters
+	const uint8_t* getFrame();
+	uint16_t getFrameLength();
+	uint32_t getStartMicros();
+	uint32_t getEndMicros();
+	uint32_t getCrcErrorCount();
+	uint32_t getResyncCount();
+	uint32_t getFilteredCount();
+
+private:
+	uint8_t _buffer[MIRA_MAX_FRAME_SIZE];
+	uint16_t _length = 0;
+	uint16_t _expected = 0;
+	bool _inFrame = false;
+	bool _escape = false;
+	bool _complete = false;
+	bool _skip = false;
+	uint16_t _subscriptions[MIRA_DECODER_CLASSES];
+	uint32_t _crcErrors = 0;
+	uint32_t _resyncs = 0;
+	uint32_t _filtered = 0;
+	uint32_t _startMicros = 0;
+	uint32_t _endMicros = 0;
+	uint16_t _byteTime = 0;
+
+	// Private functions
+	uint16_t getNeeded();
+	uint32_t getByteTime(uint32_t timestamp, size_t following);
+	void resync();
+	bool checkFrame();
+};
+
+#endif
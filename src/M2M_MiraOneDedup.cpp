@@ -0,0 +1,127 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneDedup.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraDuplicateFilter::MiraDuplicateFilter()
+{
+	clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Filtering
+//
+bool MiraDuplicateFilter::isDuplicate(const IEEE_EUI64& sender, uint16_t sequence)
+{
+	// A sender can be in one of two sets, new senders go to the one with room. This
+	// keeps sets from overflowing, where LRU eviction would thrash every sender in it.
+	uint32_t hashed = hash(sender);
+	MiraDedupEntry* sets[2] = { _entries[hashed % MIRA_DEDUP_SETS], _entries[(hashed >> 16) % MIRA_DEDUP_SETS] };
+	MiraDedupEntry* entry = nullptr;
+	MiraDedupEntry* oldest = &sets[0][0];
+	_clock++;
+	for (uint8_t i = 0; i < 2 * MIRA_DEDUP_WAYS && entry == nullptr; i++)
+	{
+		MiraDedupEntry* candidate = &sets[i / MIRA_DEDUP_WAYS][i % MIRA_DEDUP_WAYS];
+		if (memcmp(&candidate->sender, &sender, sizeof(IEEE_EUI64)) == 0 && candidate->window != 0)
+		{
+			entry = candidate;
+		}
+		// Unused entries have an empty window and are taken first
+		else if (candidate->window == 0)
+		{
+			if (oldest->window != 0)
+			{
+				oldest = candidate;
+			}
+		}
+		else if (oldest->window != 0 && _clock - candidate->lastUsed > _clock - oldest->lastUsed)
+		{
+			oldest = candidate;
+		}
+	}
+	uint32_t now = millis();
+	if (entry == nullptr)
+	{
+		entry = oldest;
+		entry->sender = sender;
+		entry->highest = sequence;
+		entry->window = 1;
+		entry->lastUsed = _clock;
+		entry->heardAt = now;
+		return false;
+	}
+	uint32_t silent = now - entry->heardAt;
+	entry->lastUsed = _clock;
+	entry->heardAt = now;
+	int16_t ahead = static_cast<int16_t>(sequence - entry->highest);
+	if (ahead > 0)
+	{
+		entry->window = ahead >= MIRA_DEDUP_WINDOW ? 1 : (entry->window << ahead) | 1;
+		entry->highest = sequence;
+		return false;
+	}
+	uint16_t behind = static_cast<uint16_t>(-ahead);
+	uint32_t bit = behind < MIRA_DEDUP_WINDOW ? 1UL << behind : 0;
+	if (bit == 0 || ((entry->window & bit) && silent >= MIRA_DEDUP_RESTART_GAP))
+	{
+		// The sender restarted, its new sequence starts a new window
+		entry->highest = sequence;
+		entry->window = 1;
+		return false;
+	}
+	if (entry->window & bit)
+	{
+		_duplicates++;
+		return true;
+	}
+	entry->window |= bit;
+	return false;
+}
+
+void MiraDuplicateFilter::clear()
+{
+	memset(_entries, 0, sizeof(_entries));
+	_clock = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint32_t MiraDuplicateFilter::getDuplicateCount()
+{
+	return _duplicates;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+uint32_t MiraDuplicateFilter::hash(const IEEE_EUI64& sender)
+{
+	// FNV-1a, the low and high halves pick the two sets
+	uint32_t result = 2166136261UL;
+	for (uint8_t i = 0; i < sizeof(IEEE_EUI64); i++)
+	{
+		result ^= sender.data[i];
+		result *= 16777619UL;
+	}
+	return result;
+}
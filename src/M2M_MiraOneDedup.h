@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Duplicate suppression for received data.
+//
+// Each sender gets a sliding window over its most recent sequence numbers, kept as a bitmap
+// relative to the highest sequence number seen. Senders are stored in a set associative
+// table, each sender in one of two sets, so lookups are O(1) and memory is fixed. When
+// both sets are full the least recently heard sender in them is evicted. Host builds have
+// room for 4096 senders.
+//
+// A restarted sender starts again from sequence 0. A frame further behind than the window
+// is taken as such a restart, whether or not sequence 0 itself arrived, and starts a new
+// window. A sender that repeats a sequence number in its window after being silent for
+// MIRA_DEDUP_RESTART_GAP ms has restarted as well, re-routed copies arrive well within that.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEDEDUP_h__
+#define __M2M_MIRAONEDEDUP_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_DEDUP_SETS
+#ifdef MIRA_HOST_BUILD
+#define MIRA_DEDUP_SETS		512		// Number of sets, senders tracked is sets * ways
+#else
+#define MIRA_DEDUP_SETS		8
+#endif
+#endif
+#ifndef MIRA_DEDUP_WAYS
+#ifdef MIRA_HOST_BUILD
+#define MIRA_DEDUP_WAYS		8
+#else
+#define MIRA_DEDUP_WAYS		4
+#endif
+#endif
+#define MIRA_DEDUP_WINDOW	32		// Sequence numbers per sender, bits in the window
+
+#ifndef MIRA_DEDUP_RESTART_GAP
+#define MIRA_DEDUP_RESTART_GAP	10000	// ms of silence after which a repeat is a restart
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+struct MiraDedupEntry
+{
+	IEEE_EUI64 sender;
+	uint32_t window;		// Bit n set means highest - n has been seen
+	uint16_t highest;
+	uint32_t lastUsed;		// Filter clock, for least recently heard eviction
+	uint32_t heardAt;		// millis()
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraDuplicateFilter
+{
+public:
+	// Constructor
+	MiraDuplicateFilter();
+
+	// Filtering
+	bool isDuplicate(const IEEE_EUI64& sender, uint16_t sequence);
+	void clear();
+
+	// Property getters
+	uint32_t getDuplicateCount();
+
+private:
+	MiraDedupEntry _entries[MIRA_DEDUP_SETS][MIRA_DEDUP_WAYS];
+	uint32_t _clock = 0;
+	uint32_t _duplicates = 0;
+
+	// Private functions
+	static uint32_t hash(const IEEE_EUI64& sender);
+};
+
+#endif
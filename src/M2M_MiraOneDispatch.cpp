@@ -0,0 +1,276 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneDispatch.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraFrameView
+//
+MiraFrameView::MiraFrameView(const uint8_t* frame, uint16_t length, uint32_t startMicros, uint32_t endMicros)
+{
+	// frame is an unescaped frame without STC and CRC, as produced by MiraFrameDecoder,
+	// the times are when its STC and last byte arrived
+	_frame = frame;
+	_length = length;
+	_startMicros = startMicros;
+	_endMicros = endMicros;
+	_dataOffset = 4;
+	if (hasAddress())
+	{
+		_dataOffset += (frame[4] & 0b00001111) == MIRA_ADDRESS_TYPE_EUI64 ? 9 : 1;
+	}
+	_dataSize = frame[3];
+	if (_dataOffset + _dataSize > length)
+	{
+		_dataSize = length > _dataOffset ? length - _dataOffset : 0;
+	}
+}
+
+bool MiraFrameView::isResponse() const
+{
+	return (_frame[0] & MIRA_MESSAGE_RESPONSE_FLAG) == MIRA_MESSAGE_RESPONSE_FLAG;
+}
+
+bool MiraFrameView::hasAddress() const
+{
+	return (_frame[0] & MIRA_MESSAGE_ADDRESS_FLAG) == MIRA_MESSAGE_ADDRESS_FLAG;
+}
+
+uint8_t MiraFrameView::getMessageClass() const
+{
+	return static_cast<uint8_t>(_frame[0] & MIRA_MESSAGE_CLASS_FLAGS);
+}
+
+uint8_t MiraFrameView::getMessageType() const
+{
+	return _frame[1];
+}
+
+uint8_t MiraFrameView::getMessageIndex() const
+{
+	return _frame[2];
+}
+
+uint8_t MiraFrameView::getAddressingMode() const
+{
+	if (!hasAddress())
+	{
+		return MIRA_ADDRESSING_MODE_NONE;
+	}
+	return static_cast<uint8_t>(_frame[4] >> 4);
+}
+
+uint8_t MiraFrameView::getAddressType() const
+{
+	if (!hasAddress())
+	{
+		return MIRA_ADDRESS_TYPE_NOADDRESS;
+	}
+	return static_cast<uint8_t>(_frame[4] & 0b00001111);
+}
+
+bool MiraFrameView::getEUI64Address(IEEE_EUI64& address) const
+{
+	if (getAddressType() != MIRA_ADDRESS_TYPE_EUI64)
+	{
+		return false;
+	}
+	memcpy(&address, &_frame[5], sizeof(IEEE_EUI64));
+	return true;
+}
+
+uint8_t MiraFrameView::getDataSize() const
+{
+	return _dataSize;
+}
+
+const uint8_t* MiraFrameView::getData() const
+{
+	return &_frame[_dataOffset];
+}
+
+const uint8_t* MiraFrameView::getFrame() const
+{
+	return _frame;
+}
+
+uint16_t MiraFrameView::getLength() const
+{
+	return _length;
+}
+
+uint32_t MiraFrameView::getStartMicros() const
+{
+	return _startMicros;
+}
+
+uint32_t MiraFrameView::getEndMicros() const
+{
+	return _endMicros;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraDispatcher
+//
+MiraDispatcher::MiraDispatcher()
+{
+	clear();
+}
+
+#if MIRA_DISPATCH_HANDLERS == 0
+bool MiraDispatcher::setHandler(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	if (messageClass >= MIRA_DISPATCH_CLASSES || messageType >= MIRA_DISPATCH_TYPES)
+	{
+		return false;
+	}
+	_handlers[messageClass][messageType].handler = framehandler;
+	_handlers[messageClass][messageType].context = context;
+	return true;
+}
+
+bool MiraDispatcher::setHandler(uint8_t messageClass, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	// Every type of the class, for classes such as firmware upgrade
+	if (messageClass >= MIRA_DISPATCH_CLASSES)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < MIRA_DISPATCH_TYPES; i++)
+	{
+		_handlers[messageClass][i].handler = framehandler;
+		_handlers[messageClass][i].context = context;
+	}
+	return true;
+}
+
+void MiraDispatcher::clear()
+{
+	memset(_handlers, 0, sizeof(_handlers));
+}
+
+bool MiraDispatcher::dispatch(const MiraFrameView& frame)
+{
+	uint8_t messageType = frame.getMessageType();
+	if (messageType >= MIRA_DISPATCH_TYPES)
+	{
+		return false;
+	}
+	MiraFrameHandler* entry = &_handlers[frame.getMessageClass()][messageType];
+	if (entry->handler == nullptr)
+	{
+		return false;
+	}
+	(entry->handler)(entry->context, frame);
+	return true;
+}
+#else
+bool MiraDispatcher::setHandler(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	if (messageClass >= MIRA_DISPATCH_CLASSES || messageType >= MIRA_DISPATCH_TYPES)
+	{
+		return false;
+	}
+	// Removing a type of a class with a class handler keeps an empty entry to hide it
+	bool hides = framehandler == nullptr && find(messageClass, MIRA_DISPATCH_ALL_TYPES) != nullptr;
+	MiraFrameRoute* route = find(messageClass, messageType);
+	if (route == nullptr)
+	{
+		return (framehandler == nullptr && !hides) || add(messageClass, messageType, framehandler, context);
+	}
+	if (framehandler == nullptr && !hides)
+	{
+		route->messageClass = MIRA_DISPATCH_CLASSES;
+	}
+	route->target.handler = framehandler;
+	route->target.context = context;
+	return true;
+}
+
+bool MiraDispatcher::setHandler(uint8_t messageClass, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	// Every type of the class, for classes such as firmware upgrade. Replaces the handlers
+	// of single types of the class, as in the flat table.
+	if (messageClass >= MIRA_DISPATCH_CLASSES)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < MIRA_DISPATCH_HANDLERS; i++)
+	{
+		if (_routes[i].messageClass == messageClass)
+		{
+			_routes[i].messageClass = MIRA_DISPATCH_CLASSES;
+		}
+	}
+	return framehandler == nullptr || add(messageClass, MIRA_DISPATCH_ALL_TYPES, framehandler, context);
+}
+
+void MiraDispatcher::clear()
+{
+	memset(_routes, 0, sizeof(_routes));
+	for (uint8_t i = 0; i < MIRA_DISPATCH_HANDLERS; i++)
+	{
+		_routes[i].messageClass = MIRA_DISPATCH_CLASSES;
+	}
+}
+
+bool MiraDispatcher::dispatch(const MiraFrameView& frame)
+{
+	MiraFrameRoute* route = find(frame.getMessageClass(), frame.getMessageType());
+	if (route == nullptr)
+	{
+		route = find(frame.getMessageClass(), MIRA_DISPATCH_ALL_TYPES);
+	}
+	if (route == nullptr || route->target.handler == nullptr)
+	{
+		return false;
+	}
+	(route->target.handler)(route->target.context, frame);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraFrameRoute* MiraDispatcher::find(uint8_t messageClass, uint8_t messageType)
+{
+	// Free entries are found with messageClass MIRA_DISPATCH_CLASSES and any type
+	for (uint8_t i = 0; i < MIRA_DISPATCH_HANDLERS; i++)
+	{
+		if (_routes[i].messageClass == messageClass &&
+			(_routes[i].messageType == messageType || messageClass == MIRA_DISPATCH_CLASSES))
+		{
+			return &_routes[i];
+		}
+	}
+	return nullptr;
+}
+
+bool MiraDispatcher::add(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context)
+{
+	MiraFrameRoute* route = find(MIRA_DISPATCH_CLASSES, 0);
+	if (route == nullptr)
+	{
+		return false;
+	}
+	route->target.handler = framehandler;
+	route->target.context = context;
+	route->messageClass = messageClass;
+	route->messageType = messageType;
+	return true;
+}
+#endif
@@ -0,0 +1,125 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Dispatch of received frames to application handlers.
+//
+// Handlers are registered per message class and type. Host builds keep them in a flat 16 x 16
+// table, so finding the handler for a frame is a single lookup. That table takes 2 kB with
+// 32-bit pointers, microcontroller builds instead keep up to MIRA_DISPATCH_HANDLERS
+// registrations in a compact table that is searched, exact type before whole class.
+// Defining MIRA_DISPATCH_HANDLERS as 0 selects the flat table on any target.
+//
+// Handlers get a MiraFrameView, which reads the frame in place in the decoder buffer. The view
+// is only valid during the call, copy what is needed.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEDISPATCH_h__
+#define __M2M_MIRAONEDISPATCH_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_DISPATCH_CLASSES	16		// Message class is the low nibble of the header
+#define MIRA_DISPATCH_TYPES		16
+#define MIRA_DISPATCH_ALL_TYPES	0xff	// Compact table entry for every type of a class
+
+#ifndef MIRA_DISPATCH_HANDLERS
+#ifdef MIRA_HOST_BUILD
+#define MIRA_DISPATCH_HANDLERS	0		// Registrations in the compact table, 0 for the flat table
+#else
+#define MIRA_DISPATCH_HANDLERS	8
+#endif
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraFrameView
+{
+public:
+	// Constructor
+	MiraFrameView(const uint8_t* frame, uint16_t length, uint32_t startMicros = 0, uint32_t endMicros = 0);
+
+	// Property getters
+	bool isResponse() const;
+	bool hasAddress() const;
+	uint8_t getMessageClass() const;
+	uint8_t getMessageType() const;
+	uint8_t getMessageIndex() const;
+	uint8_t getAddressingMode() const;
+	uint8_t getAddressType() const;
+	bool getEUI64Address(IEEE_EUI64& address) const;
+	uint8_t getDataSize() const;
+	const uint8_t* getData() const;
+	const uint8_t* getFrame() const;
+	uint16_t getLength() const;
+	uint32_t getStartMicros() const;
+	uint32_t getEndMicros() const;
+
+private:
+	const uint8_t* _frame;
+	uint32_t _startMicros;
+	uint32_t _endMicros;
+	uint16_t _length;
+	uint8_t _dataOffset;
+	uint8_t _dataSize;
+};
+
+#define FRAME_HANDLER_SIGNATURE void (*framehandler)(void* context, const MiraFrameView& frame)
+
+struct MiraFrameHandler
+{
+	void (*handler)(void* context, const MiraFrameView& frame);
+	void* context;
+};
+
+struct MiraFrameRoute
+{
+	MiraFrameHandler target;
+	uint8_t messageClass;		// MIRA_DISPATCH_CLASSES for a free entry
+	uint8_t messageType;
+};
+
+class MiraDispatcher
+{
+public:
+	// Constructor
+	MiraDispatcher();
+
+	// Handlers, a nullptr handler removes the registration
+	bool setHandler(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context);
+	bool setHandler(uint8_t messageClass, FRAME_HANDLER_SIGNATURE, void* context);
+	void clear();
+
+	// Dispatching
+	bool dispatch(const MiraFrameView& frame);
+
+private:
+#if MIRA_DISPATCH_HANDLERS == 0
+	MiraFrameHandler _handlers[MIRA_DISPATCH_CLASSES][MIRA_DISPATCH_TYPES];
+#else
+	MiraFrameRoute _routes[MIRA_DISPATCH_HANDLERS];
+
+	// Private functions
+	MiraFrameRoute* find(uint8_t messageClass, uint8_t messageType);
+	bool add(uint8_t messageClass, uint8_t messageType, FRAME_HANDLER_SIGNATURE, void* context);
+#endif
+};
+
+#endif
@@ -0,0 +1,405 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Compile time typed frames.
+//
+// MiraFrame<Class, Type, PayloadT, AddressT, Response> is a frame with a fixed layout, the
+// MESSAGE_* pairs can be used for the first two arguments:
+//
+//   struct __attribute__((packed)) Reading { uint16_t temperature; uint8_t battery; };
+//   MiraDataSendToRoot<Reading> frame;
+//   frame.payload.temperature = 215;
+//   mira.sendFrame(frame, MiraTxClass::interactive);
+//
+// Header, address and payload sizes are constants, so encode() compiles to straight-line
+// code. MiraOne::sendFrame() encodes into the transmit ring with it when nothing is queued
+// ahead of the frame. Only class/type pairs described by MiraMessageTraits can be used,
+// and each direction of a message only accepts its payload, anything else fails to
+// compile. Data messages take any application payload.
+//
+// The direction follows from the payload, MiraFrame<MESSAGE_GET_VERSION> is the command
+// and MiraFrame<MESSAGE_GET_VERSION, MiraVersionPayload> the module's response to it.
+// MiraResponseFrame<> picks the response for messages with the same payload both ways.
+//
+// Received frames are decoded with decode(), or by a typed handler registered with
+// MiraOne::setFrameHandler<FrameT, handler>(context), which takes the class and type from
+// the frame type. Only frames with the response flag of the frame type match.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEFRAME_h__
+#define __M2M_MIRAONEFRAME_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+#include "M2M_MiraOneDispatch.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Payload definitions
+//
+struct MiraNoPayload
+{
+};
+
+struct MiraNoFrame			// The message is not sent in this direction
+{
+};
+
+struct __attribute__((packed)) MiraVersionPayload
+{
+	uint8_t major;
+	uint8_t minor;
+};
+
+struct __attribute__((packed)) MiraEUI64Payload
+{
+	IEEE_EUI64 address;
+};
+
+struct __attribute__((packed)) MiraIntervalPayload
+{
+	uint8_t interval;
+};
+
+struct __attribute__((packed)) MiraCredentialsPayload
+{
+	uint16_t networkId;
+	uint8_t aesKey[16];
+};
+
+struct __attribute__((packed)) MiraAntennaPayload
+{
+	uint8_t antenna;
+};
+
+struct __attribute__((packed)) MiraStatisticsPayload
+{
+	IEEE_EUI64 node;
+	IEEE_EUI64 parent;
+	uint8_t osMajor;
+	uint8_t osMinor;
+	uint8_t linkQuality;		// Channel error rates follow in later firmware
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Address definitions
+//
+struct MiraNoAddress
+{
+	enum { size = 0 };
+	void encode(uint8_t*) const {}
+	bool decode(const MiraFrameView&) { return true; }
+};
+
+struct MiraRootAddress
+{
+	enum { size = 1 };
+	void encode(uint8_t* buffer) const { buffer[0] = MIRA_ADDRESS_NETWORK_ROOT; }
+	bool decode(const MiraFrameView&) { return true; }
+};
+
+struct MiraBroadcastAddress
+{
+	enum { size = 1 };
+	void encode(uint8_t* buffer) const { buffer[0] = MIRA_ADDRESS_BROADCAST; }
+	bool decode(const MiraFrameView&) { return true; }
+};
+
+struct MiraNodeAddress
+{
+	enum { size = 9 };
+	IEEE_EUI64 address;
+
+	void encode(uint8_t* buffer) const
+	{
+		buffer[0] = MIRA_ADDRESSING_MODE_ADDRESS << 4 | MIRA_ADDRESS_TYPE_EUI64;
+		memcpy(&buffer[1], &address, sizeof(IEEE_EUI64));
+	}
+	bool decode(const MiraFrameView& frame) { return frame.getEUI64Address(address); }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Message traits
+//
+// Request is the payload of frames sent to the module, Response the payload of frames sent by
+// it. void is a message without a fixed layout, which then takes any payload type.
+//
+template<uint8_t Class, uint8_t Type>
+struct MiraMessageTraits;
+
+#define MIRA_MESSAGE_TRAITS(message, request, response) \
+	template<> struct MiraMessageTraits<message> \
+	{ \
+		typedef request Request; \
+		typedef response Response; \
+	}
+
+MIRA_MESSAGE_TRAITS(MESSAGE_GET_VERSION, MiraNoPayload, MiraVersionPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_GET_EUI64INFO, MiraNoPayload, MiraEUI64Payload);
+MIRA_MESSAGE_TRAITS(MESSAGE_DATA_SEND, void, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_DATA_RECEIVED, MiraNoFrame, void);
+MIRA_MESSAGE_TRAITS(MESSAGE_SLEEPY_DATA_RECEIVED, MiraNoFrame, void);
+MIRA_MESSAGE_TRAITS(MESSAGE_DATA_MAIL, MiraNoPayload, void);
+MIRA_MESSAGE_TRAITS(MESSAGE_NETWORK_GET_STATISTICS, MiraIntervalPayload, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_NETWORK_PING, void, void);
+MIRA_MESSAGE_TRAITS(MESSAGE_NETWORK_STATISTICS, MiraNoFrame, MiraStatisticsPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_NETWORK_PONG, MiraNoFrame, void);
+MIRA_MESSAGE_TRAITS(MESSAGE_SETTINGS_SET_CREDENTIALS, MiraCredentialsPayload, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_SETTINGS_BECOME_ROOT, MiraNoPayload, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_SETTINGS_SET_ANTENNA, MiraAntennaPayload, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_SETTINGS_SET_NAME, void, MiraNoPayload);
+MIRA_MESSAGE_TRAITS(MESSAGE_SETTINGS_COMMIT, MiraNoPayload, MiraNoPayload);
+
+// ACK and ERROR exist in every class and are only sent by the module, the payload depends on
+// the command
+template<uint8_t Class>
+struct MiraMessageTraits<Class, MIRA_MESSAGE_TYPE_ACK>
+{
+	typedef MiraNoFrame Request;
+	typedef void Response;
+};
+
+template<uint8_t Class>
+struct MiraMessageTraits<Class, MIRA_MESSAGE_TYPE_ERROR>
+{
+	typedef MiraNoFrame Request;
+	typedef void Response;
+};
+
+template<typename PayloadT, typename ExpectedT>
+struct MiraPayloadCheck
+{
+	enum { valid = false };
+};
+
+template<typename PayloadT>
+struct MiraPayloadCheck<PayloadT, PayloadT>
+{
+	enum { valid = true };
+};
+
+template<typename PayloadT>
+struct MiraPayloadCheck<PayloadT, void>
+{
+	enum { valid = true };
+};
+
+template<>
+struct MiraPayloadCheck<void, void>
+{
+	enum { valid = false };	// Messages without a fixed layout need a payload type
+};
+
+template<typename PayloadT>
+struct MiraPayloadCheck<PayloadT, MiraNoFrame>
+{
+	enum { valid = false };
+};
+
+template<>
+struct MiraPayloadCheck<MiraNoFrame, MiraNoFrame>
+{
+	enum { valid = false };
+};
+
+// A frame is the request when the payload fits the request, and the response otherwise
+template<typename Traits, typename PayloadT>
+struct MiraFrameDirection
+{
+	enum { isResponse = !MiraPayloadCheck<PayloadT, typename Traits::Request>::valid };
+};
+
+// Without a payload type a frame is the request, or the response to messages only the
+// module sends
+template<typename RequestT, typename ResponseT>
+struct MiraDefaultPayload
+{
+	typedef RequestT Type;
+};
+
+template<typename ResponseT>
+struct MiraDefaultPayload<MiraNoFrame, ResponseT>
+{
+	typedef ResponseT Type;
+};
+
+template<typename PayloadT>
+struct MiraPayloadSize
+{
+	enum { value = sizeof(PayloadT) };
+};
+
+template<>
+struct MiraPayloadSize<MiraNoPayload>
+{
+	enum { value = 0 };
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+template<uint8_t Class, uint8_t Type,
+	typename PayloadT = typename MiraDefaultPayload<typename MiraMessageTraits<Class, Type>::Request,
+		typename MiraMessageTraits<Class, Type>::Response>::Type,
+	typename AddressT = MiraNoAddress,
+	bool Response = MiraFrameDirection<MiraMessageTraits<Class, Type>, PayloadT>::isResponse>
+class MiraFrame
+{
+	typedef MiraMessageTraits<Class, Type> Traits;
+	typedef typename Traits::Request RequestT;
+	typedef typename Traits::Response ResponseT;
+
+	static_assert(Response ? bool(MiraPayloadCheck<PayloadT, ResponseT>::valid) : bool(MiraPayloadCheck<PayloadT, RequestT>::valid),
+		"The payload type does not match the message, or is missing");
+	static_assert(MiraPayloadSize<PayloadT>::value <= 255, "The payload does not fit in a frame");
+
+public:
+	static const uint8_t messageClass = Class;
+	static const uint8_t messageType = Type;
+	static const bool isResponse = Response;
+	static const uint8_t header = Class |
+		(AddressT::size > 0 ? MIRA_MESSAGE_ADDRESS_FLAG : 0) |
+		(Response ? MIRA_MESSAGE_RESPONSE_FLAG : 0);
+	static const uint8_t payloadSize = MiraPayloadSize<PayloadT>::value;
+	static const uint16_t frameSize = 4 + AddressT::size + payloadSize + 2;	// Unescaped, without STC
+
+	AddressT address;
+	PayloadT payload;
+	uint8_t messageIndex = 0;
+
+	// Encoding, returns frameSize
+	uint16_t encode(uint8_t* buffer, uint8_t index) const
+	{
+		buffer[0] = header;
+		buffer[1] = Type;
+		buffer[2] = index;
+		buffer[3] = payloadSize;
+		address.encode(&buffer[4]);
+		memcpy(&buffer[4 + AddressT::size], &payload, payloadSize);
+		uint16_t crc = MiraOneMessage::updateCrc(0, buffer, frameSize - 2);
+		buffer[frameSize - 2] = static_cast<uint8_t>(crc >> 8);
+		buffer[frameSize - 1] = static_cast<uint8_t>(crc & 0xff);
+		return frameSize;
+	}
+
+	size_t write(Print* output, uint8_t index) const
+	{
+		uint8_t buffer[frameSize];
+		encode(buffer, index);
+		size_t written = output->write(static_cast<uint8_t>(MIRA_CHAR_STC));
+		return written + MiraOneMessage::writeEscaped(output, buffer, frameSize);
+	}
+
+	// For the MiraOne transmit queue, which keeps messages for retransmission
+	MiraOneMessage* toMessage() const
+	{
+		uint8_t buffer[AddressT::size > 0 ? AddressT::size : 1];
+		address.encode(buffer);
+		MiraOneMessage* result = new MiraOneMessage(header, Type);
+		result->setAddress(buffer, AddressT::size);
+		result->setData(reinterpret_cast<const uint8_t*>(&payload), payloadSize);
+		return result;
+	}
+
+	// Decoding
+	static bool matches(const MiraFrameView& frame)
+	{
+		return frame.getMessageClass() == Class && frame.getMessageType() == Type && frame.isResponse() == Response;
+	}
+
+	bool decode(const MiraFrameView& frame)
+	{
+		// Longer payloads are accepted, later module firmware may append fields
+		if (!matches(frame) || frame.getDataSize() < payloadSize || !address.decode(frame))
+		{
+			return false;
+		}
+		memcpy(&payload, frame.getData(), payloadSize);
+		messageIndex = frame.getMessageIndex();
+		return true;
+	}
+};
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const uint8_t MiraFrame<Class, Type, PayloadT, AddressT, Response>::messageClass;
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const uint8_t MiraFrame<Class, Type, PayloadT, AddressT, Response>::messageType;
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const bool MiraFrame<Class, Type, PayloadT, AddressT, Response>::isResponse;
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const uint8_t MiraFrame<Class, Type, PayloadT, AddressT, Response>::header;
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const uint8_t MiraFrame<Class, Type, PayloadT, AddressT, Response>::payloadSize;
+
+template<uint8_t Class, uint8_t Type, typename PayloadT, typename AddressT, bool Response>
+const uint16_t MiraFrame<Class, Type, PayloadT, AddressT, Response>::frameSize;
+
+// Frames sent by the module
+template<uint8_t Class, uint8_t Type,
+	typename PayloadT = typename MiraMessageTraits<Class, Type>::Response,
+	typename AddressT = MiraNoAddress>
+using MiraResponseFrame = MiraFrame<Class, Type, PayloadT, AddressT, true>;
+
+// Data messages
+template<typename PayloadT>
+using MiraDataSendToNode = MiraFrame<MESSAGE_DATA_SEND, PayloadT, MiraNodeAddress>;
+
+template<typename PayloadT>
+using MiraDataSendToRoot = MiraFrame<MESSAGE_DATA_SEND, PayloadT, MiraRootAddress>;
+
+template<typename PayloadT>
+using MiraDataSendBroadcast = MiraFrame<MESSAGE_DATA_SEND, PayloadT, MiraBroadcastAddress>;
+
+template<typename PayloadT>
+using MiraDataReceived = MiraFrame<MESSAGE_DATA_RECEIVED, PayloadT>;
+
+template<typename PayloadT>
+using MiraSleepyDataReceived = MiraFrame<MESSAGE_SLEEPY_DATA_RECEIVED, PayloadT, MiraNodeAddress>;
+
+// Commands
+typedef MiraFrame<MESSAGE_GET_VERSION> MiraGetVersionFrame;
+typedef MiraFrame<MESSAGE_GET_EUI64INFO> MiraGetEUI64InfoFrame;
+typedef MiraFrame<MESSAGE_NETWORK_GET_STATISTICS> MiraGetStatisticsFrame;
+typedef MiraFrame<MESSAGE_SETTINGS_SET_CREDENTIALS> MiraSetCredentialsFrame;
+typedef MiraFrame<MESSAGE_SETTINGS_BECOME_ROOT> MiraBecomeRootFrame;
+typedef MiraFrame<MESSAGE_SETTINGS_SET_ANTENNA> MiraSetAntennaFrame;
+typedef MiraFrame<MESSAGE_SETTINGS_COMMIT> MiraCommitSettingsFrame;
+
+// Responses
+typedef MiraResponseFrame<MESSAGE_GET_VERSION> MiraVersionFrame;
+typedef MiraResponseFrame<MESSAGE_GET_EUI64INFO> MiraEUI64InfoFrame;
+typedef MiraResponseFrame<MESSAGE_NETWORK_STATISTICS> MiraStatisticsFrame;
+
+// Adapts a typed handler to FRAME_HANDLER_SIGNATURE, frames that do not decode are dropped
+template<typename FrameT, void (*Handler)(void* context, const FrameT& frame)>
+struct MiraTypedHandler
+{
+	static void call(void* context, const MiraFrameView& view)
+	{
+		FrameT frame;
+		if (frame.decode(view))
+		{
+			Handler(context, frame);
+		}
+	}
+};
+
+#endif
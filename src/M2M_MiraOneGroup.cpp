@@ -0,0 +1,218 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneGroup.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraOneGroup::MiraOneGroup(MiraGroupPolicy policy)
+{
+	_policy = policy;
+}
+
+MiraOneGroup::~MiraOneGroup()
+{
+	while (_queueCount > 0)
+	{
+		delete getNextMessage();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Infrastructure
+//
+bool MiraOneGroup::add(MiraOne* module)
+{
+	if (_moduleCount >= MIRA_GROUP_MAX_MODULES)
+	{
+		return false;
+	}
+	_modules[_moduleCount++] = module;
+	return true;
+}
+
+void MiraOneGroup::update()
+{
+	if (_moduleCount == 0)
+	{
+		return;
+	}
+	for (uint8_t i = 0; i < _moduleCount; i++)
+	{
+		_modules[(_start + i) % _moduleCount]->update();
+	}
+	// Merge by receive time, frames left behind when the group queue is full stay in the
+	// module queues
+	while (_queueCount < MIRA_GROUP_QUEUE_SIZE)
+	{
+		uint8_t earliest = MIRA_GROUP_MAX_MODULES;
+		uint32_t earliestAt = 0;
+		for (uint8_t i = 0; i < _moduleCount; i++)
+		{
+			uint8_t radio = (_start + i) % _moduleCount;
+			MiraOneMessage* head = _modules[radio]->peekQueuedMessage();
+			if (head == nullptr)
+			{
+				continue;
+			}
+			uint32_t receivedAt = head->getRxEndMicros();
+			if (earliest == MIRA_GROUP_MAX_MODULES || (int32_t)(receivedAt - earliestAt) < 0)
+			{
+				earliest = radio;
+				earliestAt = receivedAt;
+			}
+		}
+		if (earliest == MIRA_GROUP_MAX_MODULES)
+		{
+			break;
+		}
+		MiraGroupEntry* entry = &_queue[(_queueHead + _queueCount) % MIRA_GROUP_QUEUE_SIZE];
+		entry->message = _modules[earliest]->getQueuedMessage();
+		entry->radio = earliest;
+		_queueCount++;
+	}
+	_start = (_start + 1) % _moduleCount;
+}
+
+uint8_t MiraOneGroup::getModuleCount()
+{
+	return _moduleCount;
+}
+
+MiraOne* MiraOneGroup::getModule(uint8_t radio)
+{
+	return radio < _moduleCount ? _modules[radio] : nullptr;
+}
+
+void MiraOneGroup::setPolicy(MiraGroupPolicy policy)
+{
+	_policy = policy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Messaging
+//
+bool MiraOneGroup::available()
+{
+	return _queueCount > 0;
+}
+
+MiraSendResult MiraOneGroup::send(MiraOneMessage* message)
+{
+	return send(message, MiraTxScheduler::getDefaultClass(message));
+}
+
+MiraSendResult MiraOneGroup::send(MiraOneMessage* message, MiraTxClass txClass)
+{
+	if (_moduleCount == 0)
+	{
+		return MiraSendResult::wouldBlock;
+	}
+	IEEE_EUI64 destination;
+	if (!message->getEUI64Address(destination))
+	{
+		return _modules[0]->send(message, txClass);
+	}
+	uint8_t radio = selectRadio(destination);
+	MiraSendResult result = _modules[radio]->send(message, txClass);
+	if (result == MiraSendResult::ok || _policy == MiraGroupPolicy::byDestination)
+	{
+		return result;
+	}
+	// Try the other radios before reporting back pressure
+	for (uint8_t i = 1; i < _moduleCount; i++)
+	{
+		result = _modules[(radio + i) % _moduleCount]->send(message, txClass);
+		if (result == MiraSendResult::ok)
+		{
+			break;
+		}
+	}
+	return result;
+}
+
+MiraSendResult MiraOneGroup::send(uint8_t radio, MiraOneMessage* message, MiraTxClass txClass)
+{
+	if (radio >= _moduleCount)
+	{
+		return MiraSendResult::wouldBlock;
+	}
+	return _modules[radio]->send(message, txClass);
+}
+
+MiraOneMessage* MiraOneGroup::getNextMessage(uint8_t* radio)
+{
+	if (_queueCount == 0)
+	{
+		return nullptr;
+	}
+	MiraGroupEntry* entry = &_queue[_queueHead];
+	_queueHead = (_queueHead + 1) % MIRA_GROUP_QUEUE_SIZE;
+	_queueCount--;
+	if (radio != nullptr)
+	{
+		*radio = entry->radio;
+	}
+	return entry->message;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+uint8_t MiraOneGroup::selectRadio(const IEEE_EUI64& destination)
+{
+	switch (_policy)
+	{
+		case MiraGroupPolicy::leastLoaded:
+		{
+			uint8_t best = 0;
+			for (uint8_t i = 1; i < _moduleCount; i++)
+			{
+				if (getLoad(i) < getLoad(best))
+				{
+					best = i;
+				}
+			}
+			return best;
+		}
+		case MiraGroupPolicy::roundRobin:
+		{
+			uint8_t radio = _nextRadio % _moduleCount;
+			_nextRadio = (radio + 1) % _moduleCount;
+			return radio;
+		}
+		default:
+		{
+			uint8_t hash = 0;
+			for (uint8_t i = 0; i < sizeof(IEEE_EUI64); i++)
+			{
+				hash = (hash << 1 | hash >> 7) ^ destination.data[i];
+			}
+			return hash % _moduleCount;
+		}
+	}
+}
+
+uint16_t MiraOneGroup::getLoad(uint8_t radio)
+{
+	// Frames waiting to be written weigh more than used send credits
+	MiraOne* module = _modules[radio];
+	uint8_t usedCredits = module->getSendWindow() - module->getSendCredits();
+	return module->getTxQueueCount() * 2 + usedCredits;
+}
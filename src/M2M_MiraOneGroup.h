@@ -0,0 +1,102 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Runs several MiraOne modules from one service loop.
+//
+// update() services every module, starting with a different one on each call, and merges
+// the received frames into one queue in the order they were received. The head frame with
+// the earliest end of frame time across the modules is taken first, frames received at the
+// same time are taken starting from the module serviced first. Each frame is tagged with the
+// index of the radio it came from, which is the order in which the modules were added.
+//
+// Unicast data is spread over the modules according to the selected policy. Frames without
+// an EUI64 destination are sent on the first module unless a radio is given explicitly.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEGROUP_h__
+#define __M2M_MIRAONEGROUP_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOne.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_GROUP_MAX_MODULES
+#define MIRA_GROUP_MAX_MODULES		4
+#endif
+
+#ifndef MIRA_GROUP_QUEUE_SIZE
+#define MIRA_GROUP_QUEUE_SIZE		16
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraGroupPolicy: uint8_t
+{
+	byDestination = 0,		// Same node always uses the same radio, keeps per node ordering
+	leastLoaded = 1,		// Radio with most free send credits and shortest queue
+	roundRobin = 2
+};
+
+struct MiraGroupEntry
+{
+	MiraOneMessage* message;
+	uint8_t radio;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraOneGroup
+{
+public:
+	// Constructor/Destructor
+	MiraOneGroup(MiraGroupPolicy policy = MiraGroupPolicy::byDestination);
+	~MiraOneGroup();
+
+	// Infrastructure
+	bool add(MiraOne* module);
+	void update();
+	uint8_t getModuleCount();
+	MiraOne* getModule(uint8_t radio);
+	void setPolicy(MiraGroupPolicy policy);
+
+	// Messaging
+	bool available();
+	MiraSendResult send(MiraOneMessage* message);
+	MiraSendResult send(MiraOneMessage* message, MiraTxClass txClass);
+	MiraSendResult send(uint8_t radio, MiraOneMessage* message, MiraTxClass txClass);
+	MiraOneMessage* getNextMessage(uint8_t* radio = nullptr);
+
+private:
+	MiraOne* _modules[MIRA_GROUP_MAX_MODULES];
+	uint8_t _moduleCount = 0;
+	uint8_t _start = 0;
+	uint8_t _nextRadio = 0;
+	MiraGroupPolicy _policy;
+	MiraGroupEntry _queue[MIRA_GROUP_QUEUE_SIZE];
+	uint8_t _queueHead = 0;
+	uint8_t _queueCount = 0;
+
+	// Private functions
+	uint8_t selectRadio(const IEEE_EUI64& destination);
+	uint16_t getLoad(uint8_t radio);
+};
+
+#endif
@@ -0,0 +1,131 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneHistogram.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraHistogram::MiraHistogram()
+{
+	reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Recording
+//
+void MiraHistogram::add(uint32_t value)
+{
+	_buckets[getBucket(value)]++;
+	if (_count == 0 || value < _min)
+	{
+		_min = value;
+	}
+	if (value > _max)
+	{
+		_max = value;
+	}
+	_count++;
+	_sum += value;
+}
+
+void MiraHistogram::reset()
+{
+	memset(_buckets, 0, sizeof(_buckets));
+	_count = 0;
+	_min = 0;
+	_max = 0;
+	_sum = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint32_t MiraHistogram::getCount()
+{
+	return _count;
+}
+
+uint32_t MiraHistogram::getMin()
+{
+	return _min;
+}
+
+uint32_t MiraHistogram::getMax()
+{
+	return _max;
+}
+
+uint32_t MiraHistogram::getMean()
+{
+	return _count > 0 ? static_cast<uint32_t>(_sum / _count) : 0;
+}
+
+uint32_t MiraHistogram::getPercentile(uint8_t percent)
+{
+	if (_count == 0)
+	{
+		return 0;
+	}
+	// Nearest rank
+	uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(_count) * percent + 99) / 100);
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+	uint32_t seen = 0;
+	for (uint8_t i = 0; i < MIRA_HISTOGRAM_BUCKETS; i++)
+	{
+		seen += _buckets[i];
+		if (seen >= rank)
+		{
+			uint32_t limit = getBucketLimit(i);
+			return limit < _max ? limit : _max;
+		}
+	}
+	return _max;
+}
+
+uint32_t MiraHistogram::getBucketCount(uint8_t bucket)
+{
+	return bucket < MIRA_HISTOGRAM_BUCKETS ? _buckets[bucket] : 0;
+}
+
+uint32_t MiraHistogram::getBucketLimit(uint8_t bucket)
+{
+	// Largest value counted in the bucket
+	if (bucket >= MIRA_HISTOGRAM_BUCKETS - 1)
+	{
+		return 0xffffffff;
+	}
+	return bucket == 0 ? 0 : (static_cast<uint32_t>(1) << bucket) - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+uint8_t MiraHistogram::getBucket(uint32_t value)
+{
+	if (value == 0)
+	{
+		return 0;
+	}
+	// Bit length of the value, unsigned long is 32 or 64 bits
+	uint8_t bits = sizeof(unsigned long) * 8 - __builtin_clzl(value);
+	return bits < MIRA_HISTOGRAM_BUCKETS ? bits : MIRA_HISTOGRAM_BUCKETS - 1;
+}
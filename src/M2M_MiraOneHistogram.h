@@ -0,0 +1,68 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Latency histogram with power of two buckets.
+//
+// Bucket 0 counts zero, bucket n counts values from 2^(n-1) up to 2^n - 1, and the last
+// bucket everything above. Adding a value is a bit scan and an increment, so it can be done
+// for every received frame. Percentiles are reported as the upper limit of the bucket they
+// fall in, never above the largest value seen.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEHISTOGRAM_h__
+#define __M2M_MIRAONEHISTOGRAM_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_HISTOGRAM_BUCKETS		25		// Up to 2^23 us, about 8 s, in the last regular bucket
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraHistogram
+{
+public:
+	// Constructor
+	MiraHistogram();
+
+	// Recording
+	void add(uint32_t value);
+	void reset();
+
+	// Property getters
+	uint32_t getCount();
+	uint32_t getMin();
+	uint32_t getMax();
+	uint32_t getMean();
+	uint32_t getPercentile(uint8_t percent);
+	uint32_t getBucketCount(uint8_t bucket);
+	static uint32_t getBucketLimit(uint8_t bucket);
+
+private:
+	uint32_t _buckets[MIRA_HISTOGRAM_BUCKETS];
+	uint32_t _count;
+	uint32_t _min;
+	uint32_t _max;
+	uint64_t _sum;
+
+	// Private functions
+	static uint8_t getBucket(uint32_t value);
+};
+
+#endif
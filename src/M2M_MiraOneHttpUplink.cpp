@@ -0,0 +1,244 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneHttpUplink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraCountingPrint
+//
+size_t MiraCountingPrint::write(uint8_t)
+{
+	_count++;
+	return 1;
+}
+
+size_t MiraCountingPrint::write(const uint8_t*, size_t size)
+{
+	_count += size;
+	return size;
+}
+
+size_t MiraCountingPrint::getCount()
+{
+	return _count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraChunkPrint
+//
+MiraChunkPrint::MiraChunkPrint(Print* output)
+{
+	_output = output;
+}
+
+size_t MiraChunkPrint::write(uint8_t value)
+{
+	return write(&value, 1);
+}
+
+size_t MiraChunkPrint::write(const uint8_t* buffer, size_t size)
+{
+	size_t written = 0;
+	while (written < size)
+	{
+		if (_length == MIRA_HTTP_CHUNK_SIZE)
+		{
+			flush();
+		}
+		size_t length = MIRA_HTTP_CHUNK_SIZE - _length;
+		if (length > size - written)
+		{
+			length = size - written;
+		}
+		memcpy(&_chunk[_length], &buffer[written], length);
+		_length += length;
+		written += length;
+	}
+	return written;
+}
+
+void MiraChunkPrint::flush()
+{
+	// Nothing more is passed on once the output has cut a chunk short
+	if (_length > 0 && !_failed)
+	{
+		_failed = _output->write(_chunk, _length) < _length;
+	}
+	_length = 0;
+}
+
+bool MiraChunkPrint::hasFailed()
+{
+	return _failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraHttpUplink::MiraHttpUplink(Client& client, const char* host, uint16_t port, const char* path)
+{
+	_client = &client;
+	_host = host;
+	_port = port;
+	_path = path;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraUplink
+//
+bool MiraHttpUplink::begin(const MiraBridgeBatch& batch)
+{
+	if (!_client->connect(_host, _port))
+	{
+		_lastStatus = 0;
+		return false;
+	}
+	MiraCountingPrint counter;
+	writeBody(&counter, batch);
+
+	MiraChunkPrint out(_client);
+	out.print(F("POST "));
+	writePath(&out, batch);
+	out.print(F(" HTTP/1.1\r\nHost: "));
+	out.print(_host);
+	out.print(F("\r\nContent-Type: application/json\r\nConnection: close\r\nContent-Length: "));
+	out.print(static_cast<unsigned long>(counter.getCount()));
+	out.print(F("\r\n\r\n"));
+	writeBody(&out, batch);
+	out.flush();
+	if (out.hasFailed())
+	{
+		_client->stop();
+		_lastStatus = 0;
+		return false;
+	}
+	_client->flush();
+
+	_statusLength = 0;
+	_startedAt = millis();
+	_active = true;
+	return true;
+}
+
+MiraUplinkStatus MiraHttpUplink::poll()
+{
+	if (!_active)
+	{
+		return MiraUplinkStatus::failed;
+	}
+	// Only the status line is needed, the rest of the response is discarded by stop()
+	while (_client->available() > 0)
+	{
+		int ch = _client->read();
+		if (ch < 0)
+		{
+			break;
+		}
+		if (ch == '\n' || _statusLength == MIRA_HTTP_STATUS_SIZE - 1)
+		{
+			_status[_statusLength] = '\0';
+			const char* code = strchr(_status, ' ');
+			return finish(code != nullptr ? static_cast<uint16_t>(atoi(code + 1)) : 0);
+		}
+		_status[_statusLength++] = static_cast<char>(ch);
+	}
+	if (!_client->connected() || millis() - _startedAt > MIRA_HTTP_TIMEOUT)
+	{
+		return finish(0);
+	}
+	return MiraUplinkStatus::busy;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint16_t MiraHttpUplink::getLastStatus()
+{
+	// 0 if no status line was received
+	return _lastStatus;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Request formatting
+//
+void MiraHttpUplink::writePath(Print* out, const MiraBridgeBatch& batch)
+{
+	out->print(_path);
+	if (_path[0] == '\0' || _path[strlen(_path) - 1] != '/')
+	{
+		out->print('/');
+	}
+	out->print(static_cast<unsigned int>(batch.channel));
+}
+
+void MiraHttpUplink::writeBody(Print* out, const MiraBridgeBatch& batch)
+{
+	out->print(F("{\"channel\":"));
+	out->print(static_cast<unsigned int>(batch.channel));
+	out->print(F(",\"records\":["));
+	uint16_t offset = 0;
+	MiraBridgeRecord record;
+	bool first = true;
+	while (batch.getRecord(offset, record))
+	{
+		if (!first)
+		{
+			out->print(',');
+		}
+		first = false;
+		out->print(F("{\"age\":"));
+		out->print(static_cast<unsigned int>(record.age));
+		out->print(F(",\"data\":\""));
+		writeHex(out, record.data, record.length);
+		out->print(F("\"}"));
+	}
+	out->print(F("]}"));
+}
+
+void MiraHttpUplink::writeHex(Print* out, const uint8_t* data, uint8_t length)
+{
+	static const char digits[] = "0123456789abcdef";
+	for (uint8_t i = 0; i < length; i++)
+	{
+		out->print(digits[data[i] >> 4]);
+		out->print(digits[data[i] & 0x0f]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraUplinkStatus MiraHttpUplink::finish(uint16_t status)
+{
+	_client->stop();
+	_active = false;
+	_lastStatus = status;
+	if (status >= 200 && status < 300)
+	{
+		return MiraUplinkStatus::done;
+	}
+	// Timeouts and rate limiting are worth another attempt, other client errors are not
+	if (status >= 400 && status < 500 && status != 408 && status != 429)
+	{
+		return MiraUplinkStatus::rejected;
+	}
+	return MiraUplinkStatus::failed;
+}
@@ -0,0 +1,117 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// HTTP uplink for MiraBridge, posting each batch as one request over an Arduino Client.
+//
+// The default request is POST <path>/<channel> with a JSON body:
+//
+//   {"channel":1,"records":[{"age":120,"data":"0a1b2c"},...]}
+//
+// Services with their own format override writePath() and writeBody(). The body is written
+// twice, once to count its length for the Content-Length header. The request goes to the
+// client in chunks of MIRA_HTTP_CHUNK_SIZE bytes. begin() connects and sends
+// the request, poll() waits for the status line without blocking.
+//
+// The connect and the writes in begin() block until the client returns, for most Arduino
+// clients that is up to their connection timeout. The gateway loop stops servicing the radio
+// for that long, so keep the MiraOne receive queue deep enough to cover it. A request the
+// client does not take whole fails the batch. A 4xx status other than 408 and 429 rejects
+// the batch, which is then dropped instead of retried.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEHTTPUPLINK_h__
+#define __M2M_MIRAONEHTTPUPLINK_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include <Client.h>
+#include "M2M_MiraOneBridge.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_HTTP_TIMEOUT			10000	// ms for the status line to arrive
+#define MIRA_HTTP_STATUS_SIZE		16		// "HTTP/1.1 200" and some
+
+#ifndef MIRA_HTTP_CHUNK_SIZE
+#define MIRA_HTTP_CHUNK_SIZE		64		// Request bytes collected per client write
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraCountingPrint : public Print
+{
+public:
+	size_t write(uint8_t value) override;
+	size_t write(const uint8_t* buffer, size_t size) override;
+	size_t getCount();
+
+private:
+	size_t _count = 0;
+};
+
+// Collects the request into chunks, so the client sees a few large writes and not one per
+// printed character, which would be one TCP segment each with TCP_NODELAY set
+class MiraChunkPrint : public Print
+{
+public:
+	MiraChunkPrint(Print* output);
+	size_t write(uint8_t value) override;
+	size_t write(const uint8_t* buffer, size_t size) override;
+	void flush();
+	bool hasFailed();
+
+private:
+	Print* _output;
+	uint8_t _chunk[MIRA_HTTP_CHUNK_SIZE];
+	uint8_t _length = 0;
+	bool _failed = false;		// The output took fewer bytes than given
+};
+
+class MiraHttpUplink : public MiraUplink
+{
+public:
+	// Constructor
+	MiraHttpUplink(Client& client, const char* host, uint16_t port = 80, const char* path = "/");
+
+	// MiraUplink
+	bool begin(const MiraBridgeBatch& batch) override;
+	MiraUplinkStatus poll() override;
+
+	// Property getters
+	uint16_t getLastStatus();
+
+protected:
+	Client* _client;
+	const char* _host;
+	const char* _path;
+	uint16_t _port;
+
+	virtual void writePath(Print* out, const MiraBridgeBatch& batch);
+	virtual void writeBody(Print* out, const MiraBridgeBatch& batch);
+	static void writeHex(Print* out, const uint8_t* data, uint8_t length);
+
+private:
+	char _status[MIRA_HTTP_STATUS_SIZE];
+	uint8_t _statusLength = 0;
+	uint16_t _lastStatus = 0;
+	uint32_t _startedAt = 0;
+	bool _active = false;
+
+	MiraUplinkStatus finish(uint16_t status);
+};
+
+#endif
@@ -0,0 +1,106 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneMappedStore.h"
+
+#ifdef MIRA_HOST_BUILD
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraMappedStore::MiraMappedStore()
+{
+}
+
+MiraMappedStore::~MiraMappedStore()
+{
+	close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Infrastructure
+//
+bool MiraMappedStore::open(const char* path, uint32_t slotCount)
+{
+	close();
+	size_t size = getRequiredSize(slotCount);
+	int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		return false;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	// A file of another size holds another layout, it is formatted again by begin()
+	bool resume = static_cast<size_t>(info.st_size) == size;
+	if (!resume && ftruncate(fd, size) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+	_fd = fd;
+	_memory = memory;
+	_size = size;
+	if (!begin(memory, size, resume))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MiraMappedStore::sync()
+{
+	if (_memory != nullptr)
+	{
+		msync(_memory, _size, MS_ASYNC);
+	}
+}
+
+void MiraMappedStore::close()
+{
+	if (_memory != nullptr)
+	{
+		msync(_memory, _size, MS_SYNC);
+		munmap(_memory, _size);
+		_memory = nullptr;
+		_header = nullptr;
+		_slots = nullptr;
+	}
+	if (_fd >= 0)
+	{
+		::close(_fd);
+		_fd = -1;
+	}
+}
+
+#endif
@@ -0,0 +1,55 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// MiraRecordStore backed by a memory mapped file, for Linux gateways.
+//
+// The file is created with room for the requested number of slots and mapped shared, so
+// appends are plain memory writes and the kernel writes them back in the background. An
+// existing file with the same layout is resumed, records and the committed sequence survive
+// a restart of the gateway. sync() starts writeback of dirty pages without waiting for it.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEMAPPEDSTORE_h__
+#define __M2M_MIRAONEMAPPEDSTORE_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneStore.h"
+
+#ifdef MIRA_HOST_BUILD
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraMappedStore : public MiraRecordStore
+{
+public:
+	// Constructor/Destructor
+	MiraMappedStore();
+	~MiraMappedStore();
+
+	// Infrastructure
+	bool open(const char* path, uint32_t slotCount);
+	void sync();
+	void close();
+
+private:
+	int _fd = -1;
+	void* _memory = nullptr;
+	size_t _size = 0;
+};
+
+#endif
+
+#endif
@@ -16,6 +16,23 @@
 //
 #include "M2M_MiraOneMessage.h"
 #include "M2M_MiraOne.h"
+#include "M2M_MiraOneDecoder.h"
+#include "M2M_MiraOneRegistry.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constants
+//
+// CRC-16/KERMIT, one nibble at a time
+static const uint16_t crcNibbleTable[16] PROGMEM =
+{
+	0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+	0x8408, 0x9489, 0xa50a, 0xb58b, 0xc60c, 0xd68d, 0xe70e, 0xf78f
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
@@ -34,15 +51,35 @@ MiraOneMessage::MiraOneMessage(uint8_t header, uint8_t type)
 	_crc = 0;	
 }
 
+MiraOneMessage::MiraOneMessage(const MiraOneMessage& other)
+{
+	_messageHeader = other._messageHeader;
+	_messageType = other._messageType;
+	_messageIndex = other._messageIndex;
+	_crc = other._crc;
+	_rxStartMicros = other._rxStartMicros;
+	_rxEndMicros = other._rxEndMicros;
+	if (other._address)
+	{
+		uint8_t size = (other._address[0] & 0b00001111) == MIRA_ADDRESS_TYPE_EUI64 ? 9 : 1;
+		_address = new uint8_t[size];
+		memcpy(_address, other._address, size);
+	}
+	if (other._data)
+	{
+		setData(other._data, other._dataSize);
+	}
+}
+
 MiraOneMessage::~MiraOneMessage()
 {
 	if (_address)
 	{
-		delete _address;
+		delete[] _address;
 	}
 	if (_data)
 	{
-		delete _data;
+		delete[] _data;
 	}
 }
 
@@ -54,7 +91,7 @@ MiraOneMessage* MiraOneMessage::getDataSendMessageForRoot(uint8_t* data, uint8_t
 {
 	MiraOneMessage* result = new MiraOneMessage(MESSAGE_DATA_SEND);
 	result->_messageHeader |= MIRA_MESSAGE_ADDRESS_FLAG;
-	result->_address = new uint8_t(MIRA_ADDRESS_NETWORK_ROOT);
+	result->_address = new uint8_t[1] { MIRA_ADDRESS_NETWORK_ROOT };
 	result->setData(data, size);
 	return result;
 }
@@ -75,7 +112,7 @@ MiraOneMessage* MiraOneMessage::getDataSendMessageForBroadcast(uint8_t* data, ui
 {
 	MiraOneMessage* result = new MiraOneMessage(MESSAGE_DATA_SEND);
 	result->_messageHeader |= MIRA_MESSAGE_ADDRESS_FLAG;
-	result->_address = new uint8_t(MIRA_ADDRESS_BROADCAST);
+	result->_address = new uint8_t[1] { MIRA_ADDRESS_BROADCAST };
 	result->setData(data, size);
 	return result;	
 }
@@ -104,10 +141,9 @@ MiraOneMessage* MiraOneMessage::getNetworkPingMessage(IEEE_EUI64 address)
 	*buffer = MIRA_ADDRESSING_MODE_ADDRESS << 4 | MIRA_ADDRESS_TYPE_EUI64;
 	memcpy(buffer + 1, &address, 8);
 	result->_address = buffer;
-	buffer = new uint8_t(32);
-	memset(buffer, 0xa5, 32);
-	result->setData(buffer, 33);
-	delete buffer;
+	uint8_t payload[32];
+	memset(payload, 0xa5, sizeof(payload));
+	result->setData(payload, sizeof(payload));
 	return result;
 }
 
@@ -202,6 +238,10 @@ uint8_t MiraOneMessage::getAddressingMode()
 
 uint8_t MiraOneMessage::getAddressType()
 {
+	if (!hasAddress())
+	{
+		return MIRA_ADDRESS_TYPE_NOADDRESS;
+	}
 	return static_cast<uint8_t>(_address[0] & 0b00001111);
 }
 
@@ -220,6 +260,49 @@ uint8_t* MiraOneMessage::getData()
 	return _data;
 }
 
+bool MiraOneMessage::isDataSend()
+{
+	return !isResponse() && getMessageClass() == MIRA_MESSAGE_CLASS_DATAMESSAGE && _messageType == MIRA_MESSAGE_TYPE_DATA_SEND;
+}
+
+bool MiraOneMessage::isError()
+{
+	return _messageType == MIRA_MESSAGE_TYPE_ERROR;
+}
+
+uint8_t MiraOneMessage::getErrorCode()
+{
+	// The module reports the reason in the first data byte, 0 when there is none
+	return isError() && _dataSize > 0 && _data != nullptr ? _data[0] : 0;
+}
+
+uint32_t MiraOneMessage::getRxStartMicros()
+{
+	// micros() when the STC of a received frame arrived, 0 for frames not received
+	return _rxStartMicros;
+}
+
+uint32_t MiraOneMessage::getRxEndMicros()
+{
+	return _rxEndMicros;
+}
+
+uint16_t MiraOneMessage::getFrameSize()
+{
+	// Header, type, index and size bytes, address, data and CRC, before escaping
+	return 4 + getAddressSize() + _dataSize + 2;
+}
+
+bool MiraOneMessage::getEUI64Address(IEEE_EUI64& address)
+{
+	if (getAddressType() != MIRA_ADDRESS_TYPE_EUI64)
+	{
+		return false;
+	}
+	memcpy(&address, &_address[1], sizeof(IEEE_EUI64));
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Property setters
@@ -236,201 +319,188 @@ void MiraOneMessage::setData(const uint8_t* data, uint8_t size)
 	_dataSize = size;
 }
 
+void MiraOneMessage::setAddress(const uint8_t* address, uint8_t length)
+{
+	// Addressing byte, followed by the EUI64 for unicast. The header address flag is not
+	// changed, the caller builds the header.
+	if (_address)
+	{
+		delete[] _address;
+		_address = nullptr;
+	}
+	if (length > 0)
+	{
+		_address = new uint8_t[length];
+		memcpy(_address, address, length);
+	}
+}
+
 void MiraOneMessage::setMessageIndex(uint8_t index)
 {
 	_messageIndex = index;
 }
 
+void MiraOneMessage::setRxTime(uint32_t startMicros, uint32_t endMicros)
+{
+	_rxStartMicros = startMicros;
+	_rxEndMicros = endMicros;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Message handling
 //
-bool MiraOneMessage::write(Stream* stream, uint8_t messageIndex, Logger* logger)
+bool MiraOneMessage::write(Print* output, uint8_t messageIndex, Logger* logger)
 {
-	MOM_LOG_TRACE_START(F("Write message: "));
-	uint16_t temp = 0;
 	_messageIndex = messageIndex;
-	_crc = 0;
-	writeSTC(stream, logger);
-	writeEscapedData(stream, _messageHeader, _crc, logger);
-	writeEscapedData(stream, _messageType, _crc, logger);
-	writeEscapedData(stream, _messageIndex, _crc, logger);
-	writeEscapedData(stream, _dataSize, _crc, logger);
-	if (hasAddress())
+	uint8_t header[4] = { _messageHeader, _messageType, _messageIndex, _dataSize };
+	_crc = updateCrc(0, header, sizeof(header));
+	_crc = updateCrc(_crc, _address, getAddressSize());
+	_crc = updateCrc(_crc, _data, _dataSize);
+	uint8_t crc[2] = { static_cast<uint8_t>(_crc >> 8), static_cast<uint8_t>(_crc & 0xff) };
+
+	// Not flushed, MiraOne writes into its transmit ring and drains that as the UART has room.
+	// False if the output did not take the whole frame.
+	size_t expected = 1 + getEscapedSize(header, sizeof(header)) + getEscapedSize(_address, getAddressSize()) +
+		getEscapedSize(_data, _dataSize) + getEscapedSize(crc, sizeof(crc));
+	size_t written = output->write(static_cast<uint8_t>(MIRA_CHAR_STC));
+	written += writeEscaped(output, header, sizeof(header));
+	written += writeEscaped(output, _address, getAddressSize());
+	written += writeEscaped(output, _data, _dataSize);
+	written += writeEscaped(output, crc, sizeof(crc));
+	MOM_LOG_TRACE(F("Write message: index 0x%02x, %u of %u bytes"), _messageIndex, (unsigned int)written, (unsigned int)expected);
+	return written == expected;
+}
+
+size_t MiraOneMessage::writeEscaped(Print* output, const uint8_t* data, size_t length)
+{
+	// Runs without STC or ESC go out in one write, only the special characters are escaped.
+	// Stops at the first write the output does not take whole.
+	size_t written = 0;
+	while (length > 0)
 	{
-		writeEscapedData(stream, _address[0], _crc, logger);
-		if (getAddressType() == MIRA_ADDRESS_TYPE_EUI64)
+		size_t run = findSpecial(data, length);
+		if (run > 0)
 		{
-			for (int i = 1; i < 9; i++)
+			size_t result = output->write(data, run);
+			written += result;
+			if (result < run)
 			{
-				writeEscapedData(stream, _address[i], _crc, logger);
+				return written;
 			}
+			data += run;
+			length -= run;
+		}
+		if (length > 0)
+		{
+			uint8_t escaped[2] = { MIRA_CHAR_ESC, static_cast<uint8_t>(~*data) };
+			size_t result = output->write(escaped, sizeof(escaped));
+			written += result;
+			if (result < sizeof(escaped))
+			{
+				return written;
+			}
+			data++;
+			length--;
 		}
 	}
-	for (int i = 0; i < _dataSize; i++)
-	{
-		writeEscapedData(stream, _data[i], _crc, logger);
-	}
-	writeEscapedData(stream, static_cast<uint8_t>(_crc >> 8), temp, logger);
-	writeEscapedData(stream, static_cast<uint8_t>(_crc & 0xff), temp, logger);
-	stream->flush();
-	MOM_LOG_TRACE_END(F("[end]"));
-	return true;
+	return written;
 }
 
-void MiraOneMessage::writeSTC(Stream* stream, Logger* logger)
+size_t MiraOneMessage::getEscapedSize(const uint8_t* data, size_t length)
 {
-	MOM_LOG_TRACE_PART(F("0x%02x "), (uint8_t)MIRA_CHAR_STC);
-	stream->print((char)MIRA_CHAR_STC);
-}
-
-void MiraOneMessage::writeEscapedData(Stream* stream, uint8_t data, uint16_t& crc, Logger* logger)
-{
-	addToCrc(crc, data);
-	switch (data)
+	// Every STC or ESC takes two bytes on the wire
+	size_t size = length;
+	while (length > 0)
 	{
-		case MIRA_CHAR_STC:
-		case MIRA_CHAR_ESC:
-			MOM_LOG_TRACE_PART(F("0x%02x 0x0%2x"), (char)MIRA_CHAR_ESC, (char)~data);
-			stream->print((char)MIRA_CHAR_ESC);
-			stream->print((char)~data);
-			break;
-		default:
-			MOM_LOG_TRACE_PART(F("0x%02x "), (uint8_t)data);
-			stream->print((char)data);
+		size_t run = findSpecial(data, length);
+		if (run == length)
+		{
 			break;
+		}
+		size++;
+		data += run + 1;
+		length -= run + 1;
 	}
+	return size;
 }
 
 bool MiraOneMessage::read(Stream* stream, Logger* logger)
 {
-
-	int16_t index = -1;
-	int ch;
-	bool inAddress = false;
-	uint8_t dataCount = 0;
-	uint8_t crcCount = 0;
-	uint16_t crc = 0;
+	// Reads byte by byte so nothing after the frame is taken from the stream
+	MiraFrameDecoder decoder;
 	uint32_t timeout = millis();
 
-	MOM_LOG_TRACE_START(F("Reading message: "));
-	while (true)
+	MOM_LOG_TRACE(F("Reading message"));
+	while (!decoder.hasFrame())
 	{
-		while (!stream->available())
+		if (!stream->available())
 		{
-			//LOG_TRACE_PART(F("."));
 			if (millis() - timeout > MIRA_SERIAL_TIMEOUT)
 			{
-				MOM_LOG_TRACE_END("");
 				MOM_LOG_ERROR(F("Timout waiting for data"));
 				return false;
 			}
 			delay(2);
+			continue;
 		}
 		timeout = millis();
-		ch = stream->read();
+		int ch = stream->read();
 		if (ch == -1)
 		{
-			MOM_LOG_TRACE_END(F(" - Read failed"));
-			return NULL;
+			MOM_LOG_ERROR(F("Read failed"));
+			return false;
 		}
-		if (ch == MIRA_CHAR_ESC)		// Unescape
+		uint8_t data = static_cast<uint8_t>(ch);
+		decoder.feed(&data, 1);
+		if (decoder.getCrcErrorCount() > 0)
 		{
-			ch = stream->read();
-			if (ch == -1)
-			{
-				MOM_LOG_TRACE_END(F(" - Read failed"));
-				// Failed to read pending data, just return
-				return NULL;
-			}
-			ch = ~ch;
-		}
-		if (index == -1)		
-		{
-			if (ch != MIRA_CHAR_STC)
-			{
-				continue;
-			}			
-			else
-			{
-				index = 0;
-				continue;
-			}
-		}
-		index++;
-		switch (index)
-		{
-			case 1:
-				_messageHeader = ch;
-				addToCrc(crc, ch);
-				continue;
-			case 2:
-				_messageType = ch;
-				addToCrc(crc, ch);
-				continue;
-			case 3:
-				_messageIndex = ch;
-				addToCrc(crc, ch);
-				continue;
-			case 4:
-				_dataSize = static_cast<uint8_t>(ch);
-				dataCount = 0;
-				addToCrc(crc, ch);
-				inAddress = hasAddress();
-				continue;
-		}
-		if (inAddress)
-		{
-			addToCrc(crc, ch);
-			switch (index)
-			{
-				// Index 7-15 is the EUI64 address
-				case 15:
-					inAddress = false;
-					// Intentional fall through
-				default:
-					_address[index - 6] = ch;
-			}				
-			continue;
-		}
-		if (dataCount < _dataSize)
-		{
-			if (dataCount == 0)
-			{
-				_data = new uint8_t[_dataSize];
-			}
-			_data[dataCount] = ch;
-			addToCrc(crc, ch);
-			dataCount++;			
-			continue;
+			MOM_LOG_ERROR(F("CRC failure"));
+			return false;
 		}
+	}
+	setFrame(decoder.getFrame(), decoder.getFrameLength());
+	return true;
+}
 
-		switch (crcCount)
-		{
-			case 0: 
-				_crc = static_cast<uint16_t>(ch << 8);
-				crcCount++;
-				break;
-			case 1:
-				_crc = _crc | static_cast<uint16_t>(ch % 0xff);
-				crcCount++;
-				if (_crc == crc)
-				{
-					MOM_LOG_TRACE_END(F("(CRC OK)"));
-				}
-				else
-				{
-					MOM_LOG_TRACE_END(F("(CRC FAIL 0x%04x, 0x%04x)"), _crc, crc);
-				}
-				return _crc == crc;
-		}
+void MiraOneMessage::setFrame(const uint8_t* frame, uint16_t length)
+{
+	// frame is an unescaped frame without STC and CRC, as produced by MiraFrameDecoder
+	if (_address)
+	{
+		delete[] _address;
+		_address = nullptr;
+	}
+	if (_data)
+	{
+		delete[] _data;
+		_data = nullptr;
+	}
+	_messageHeader = frame[0];
+	_messageType = frame[1];
+	_messageIndex = frame[2];
+	_dataSize = frame[3];
+	uint16_t position = 4;
+	if (hasAddress())
+	{
+		uint8_t size = (frame[4] & 0b00001111) == MIRA_ADDRESS_TYPE_EUI64 ? 9 : 1;
+		_address = new uint8_t[size];
+		memcpy(_address, &frame[4], size);
+		position += size;
+	}
+	if (position + _dataSize > length)
+	{
+		_dataSize = length - position;
+	}
+	if (_dataSize > 0)
+	{
+		setData(&frame[position], _dataSize);
 	}
-	return false;
 }
 
 void MiraOneMessage::dumpToLog(Logger* logger)
 {
-	if (logger->getLogLevel() != LogLevel::Trace )
+	if (logger == nullptr || logger->getLogLevel() != LogLevel::Trace)
 	{
 		return;
 	}
@@ -453,154 +523,13 @@ void MiraOneMessage::dumpToLog(Logger* logger)
 	{
 		MOM_LOG_TRACE_PART(F("False"));
 	}
-	MOM_LOG_TRACE_PART(F(", Message class: "));
-	switch (getMessageClass())
-	{
-		case 0x01:
-			MOM_LOG_TRACE_END(F("ACK)"));
-			break;
-		case 0x02:
-			MOM_LOG_TRACE_END(F("ERROR)"));
-			break;
-		case 0x03:
-			MOM_LOG_TRACE_END(F("DATA_MESSAGES)"));
-			break;
-		case 0x04:
-			MOM_LOG_TRACE_END(F("FWUP_MESSAGES)"));
-			break;
-		case 0x07:
-			MOM_LOG_TRACE_END(F("NETSTAT_MESSAGES)"));
-			break;
-		case 0x08:
-			MOM_LOG_TRACE_END(F("SETTINGS_MESSAGES)"));
-			break;
-		default:
-			MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-	}
-	MOM_LOG_TRACE_START(F("Message type    : 0x%02x ("), _messageType);
-	switch (getMessageClass())
-	{
-		case 0x03:	// DATA_MESSAGES
-			switch(_messageType)
-			{
-				case 0x01:
-					MOM_LOG_TRACE_END(F("ACK)"));
-					break;
-				case 0x02:
-					MOM_LOG_TRACE_END(F("ERROR)"));
-					break;			
-				case 0x03:
-					MOM_LOG_TRACE_END(F("DATA_SEND)"));
-					break;
-				case 0x04:
-					MOM_LOG_TRACE_END(F("DATA_RECEIVED)"));
-					break;
-				case 0x05:
-					MOM_LOG_TRACE_END(F("SLEEPY_DATA_RECEIVED)"));
-					break;
-				case 0x07:
-					MOM_LOG_TRACE_END(F("SLEEPY_DATA_MAIL)"));
-					break;
-				default:
-					MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-					break;				
-			}
-			break;
-		case 0x04:	// FWUP_MESSAGES
-			switch(_messageType)
-			{
-				case 0x01:
-					MOM_LOG_TRACE_END(F("ACK)"));
-					break;
-				case 0x02:
-					MOM_LOG_TRACE_END(F("ERROR)"));
-					break;						
-				case 0x03:
-					MOM_LOG_TRACE_END(F("FWUP_OPEN_SESSION)"));
-					break;
-				case 0x04:
-					MOM_LOG_TRACE_END(F("FWUP_CLOSE_SESSION)"));
-					break;
-				case 0x05:
-					MOM_LOG_TRACE_END(F("FWUP_SUBSCRIBE)"));
-					break;
-				case 0x06:
-					MOM_LOG_TRACE_END(F("FWUP_STATUS_REQUEST)"));
-					break;
-				case 0x07:
-					MOM_LOG_TRACE_END(F("FWUP_STATUS)"));
-					break;
-				case 0x08:
-					MOM_LOG_TRACE_END(F("FWUP_DATA_REQUEST)"));
-					break;
-				case 0x09:
-					MOM_LOG_TRACE_END(F("FWUP_DATA)"));
-					break;
-				case 0x0D:
-					MOM_LOG_TRACE_END(F("FWUP_ROLLBACK_REQUEST)"));
-					break;
-				default:
-					MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-					break;				
-			}
-			break;
-		case 0x07:	// NETSTAT_MESSAGES
-			switch(_messageType)
-			{
-				case 0x01:
-					MOM_LOG_TRACE_END(F("ACK)"));
-					break;
-				case 0x02:
-					MOM_LOG_TRACE_END(F("ERROR)"));
-					break;						
-				case 0x03:
-					MOM_LOG_TRACE_END(F("NETWORK_GET_STATISTICS)"));
-					break;
-				case 0x04:
-					MOM_LOG_TRACE_END(F("NETWORK_STATISTICS)"));
-					break;
-				case 0x09:
-					MOM_LOG_TRACE_END(F("NETWORK_PING)"));
-					break;
-				case 0x0A:
-					MOM_LOG_TRACE_END(F("NETWORK_PONG)"));
-					break;
-				default:
-					MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-					break;
-			}		
-			break;
-		case 0x08:
-			switch(_messageType)
-			{
-				case 0x01:
-					MOM_LOG_TRACE_END(F("ACK)"));
-					break;
-				case 0x02:
-					MOM_LOG_TRACE_END(F("ERROR)"));
-					break;						
-				case 0x03:
-					MOM_LOG_TRACE_END(F("SETTINGS_SET_CREDENTIALS)"));
-					break;
-				case 0x04:
-					MOM_LOG_TRACE_END(F("SETTINGS_BECOME_ROOT)"));
-					break;
-				case 0x05:
-					MOM_LOG_TRACE_END(F("SETTINGS_SET_ANTENNA)"));
-					break;
-				case 0x0A:
-					MOM_LOG_TRACE_END(F("SETTINGS_COMMIT)"));
-					break;
-				default:
-					MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-					break;				
-			}
-			break;
-		default:
-			MOM_LOG_TRACE_END(F("Unknown: 0x%02x)"), _messageType);
-			break;
-	}
-	
+	// Names come from the registry tables in PROGMEM, the logger takes them from RAM
+	MiraTextBuffer text;
+	MiraRegistry::printClassName(&text, getMessageClass());
+	MOM_LOG_TRACE_END(F(", Message class: %s)"), text.c_str());
+	text.clear();
+	MiraRegistry::printTypeName(&text, getMessageClass(), _messageType);
+	MOM_LOG_TRACE(F("Message type    : 0x%02x (%s)"), _messageType, text.c_str());
 	MOM_LOG_TRACE(F("Message index   : 0x%02x"), _messageIndex);
 	MOM_LOG_TRACE(F("Data size       : %u bytes"), _dataSize);
 	if (hasAddress())
@@ -625,37 +554,14 @@ void MiraOneMessage::dumpToLog(Logger* logger)
 			MOM_LOG_TRACE_PART(F("0x%02x "), (uint8_t)_data[i]);
 		}
 		MOM_LOG_TRACE_END("");
-	}
-	/*
-	if (getMessageClass() == 0x07 && _messageType == 0x04)
-	{
-		Log.trace(F("  Network statistics: "));
-		Log.traceStart(F("  node_eui          : "));
-		for (int i = 0; i < 8; i++)
+		MiraPayloadLayout layout = MiraRegistry::getLayout(getMessageClass(), _messageType, isResponse());
+		if (layout != MiraPayloadLayout::raw)
 		{
-			Log.tracePart(F("%02x "), (uint8_t)_data[i]);
+			text.clear();
+			MiraRegistry::printPayload(&text, layout, _data, _dataSize);
+			MOM_LOG_TRACE(F("Payload         : %s"), text.c_str());
 		}
-		Log.traceEnd("");
-		Log.traceStart(F("  parent_eui        : "));
-		for (int i = 8; i < 16; i++)
-		{
-			Log.tracePart(F("%02x "), (uint8_t)_data[i]);
-		}
-		Log.traceEnd("");
-		Log.traceStart(F("  os_version_major  : "));
-		Log.traceEnd(F("0x%02x "), (uint8_t)_data[16]);
-		Log.traceStart(F("  os_version_minor  : "));
-		Log.traceEnd(F("0x%02x "), (uint8_t)_data[17]);
-		Log.traceStart(F("  link_quality      : "));
-		Log.traceEnd(F("0x%02x "), (uint8_t)_data[18]);
-		Log.traceStart(F("  channel_error_rate : "));
-		for (int i = 19; i < 51; i = i +2)
-		{
-			Log.tracePart(F("0x%0002x "), (uint16_t)_data[i]);
-		}
-		Log.traceEnd("");	
 	}
-	*/
 	MOM_LOG_TRACE(F("==============================="));
 }
 
@@ -691,10 +597,102 @@ uint16_t MiraOneMessage::crc16Kermit(char *data, uint16_t len)
 	return crc;
 }
 
+uint16_t MiraOneMessage::updateCrc(uint16_t currentValue, const uint8_t* data, size_t length)
+{
+	while (length-- > 0)
+	{
+		currentValue ^= *data++;
+		currentValue = (currentValue >> 4) ^ pgm_read_word(&crcNibbleTable[currentValue & 0x0f]);
+		currentValue = (currentValue >> 4) ^ pgm_read_word(&crcNibbleTable[currentValue & 0x0f]);
+	}
+	return currentValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Framing
+//
+size_t MiraOneMessage::findSpecial(const uint8_t* data, size_t length)
+{
+	// Returns the offset of the first STC or ESC, or length if there is none
+	size_t position = 0;
+#if defined(__SSE2__)
+	const __m128i stc = _mm_set1_epi8(static_cast<char>(MIRA_CHAR_STC));
+	const __m128i esc = _mm_set1_epi8(static_cast<char>(MIRA_CHAR_ESC));
+	for (; position + 16 <= length; position += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, stc), _mm_cmpeq_epi8(block, esc)));
+		if (mask != 0)
+		{
+			return position + __builtin_ctz(mask);
+		}
+	}
+#elif UINTPTR_MAX > 0xffff
+	// Word at a time, a zero byte in word ^ pattern marks a match
+	const uintptr_t ones = ~static_cast<uintptr_t>(0) / 0xff;
+	const uintptr_t highs = ones * 0x80;
+	for (; position + sizeof(uintptr_t) <= length; position += sizeof(uintptr_t))
+	{
+		uintptr_t word;
+		memcpy(&word, data + position, sizeof(word));
+		uintptr_t stc = word ^ (ones * MIRA_CHAR_STC);
+		uintptr_t esc = word ^ (ones * MIRA_CHAR_ESC);
+		if ((((stc - ones) & ~stc) | ((esc - ones) & ~esc)) & highs)
+		{
+			break;
+		}
+	}
+#endif
+	for (; position < length; position++)
+	{
+		if (data[position] == MIRA_CHAR_STC || data[position] == MIRA_CHAR_ESC)
+		{
+			break;
+		}
+	}
+	return position;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Private functions
 //
+void MiraOneMessage::takeFrom(MiraOneMessage* other)
+{
+	// Moves the frame content of other into this message, leaving other empty
+	if (_address)
+	{
+		delete[] _address;
+	}
+	if (_data)
+	{
+		delete[] _data;
+	}
+	_messageHeader = other->_messageHeader;
+	_messageType = other->_messageType;
+	_messageIndex = other->_messageIndex;
+	_dataSize = other->_dataSize;
+	_address = other->_address;
+	_data = other->_data;
+	_crc = other->_crc;
+	_rxStartMicros = other->_rxStartMicros;
+	_rxEndMicros = other->_rxEndMicros;
+	other->_address = nullptr;
+	other->_data = nullptr;
+	other->_dataSize = 0;
+}
+
+uint8_t MiraOneMessage::getAddressSize()
+{
+	if (!hasAddress() || _address == nullptr)
+	{
+		return 0;
+	}
+	// Addressing byte, followed by the EUI64 for unicast
+	return getAddressType() == MIRA_ADDRESS_TYPE_EUI64 ? 9 : 1;
+}
+
 uint16_t MiraOneMessage::addToCrc(uint16_t& currentValue, uint8_t value)
 {
 	const uint16_t poly = 0x8408;	//reversed 0x1021
@@ -33,6 +33,15 @@
 #include <M2M_Logger.h>
 #include "M2M_MiraOneMessage.h"
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// External defines
+//
+// Host builds are Linux or macOS gateways using an Arduino compatible Stream
+#if !defined(MIRA_HOST_BUILD) && (defined(__linux__) || defined(__APPLE__))
+#define MIRA_HOST_BUILD
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Internal defines
@@ -67,6 +76,7 @@
 
 #define MIRA_MESSAGE_TYPE_ACK				0x01
 #define MIRA_MESSAGE_TYPE_ERROR				0x02
+#define MIRA_MESSAGE_TYPE_DATA_SEND			0x03
 #define MIRA_MESSAGE_TYPE_NETWORK_PONG		0x0a
 #define MIRA_MESSAGE_TYPE_STATISTICS		0x04
 #define MIRA_MESSAGE_TYPE_DATA_RECEIVED		0x04
@@ -77,10 +87,13 @@
 #define MESSAGE_DATA_SEND					0x03, 0x03
 #define MESSAGE_SLEEPY_DATA_RECEIVED		0x03, 0x05
 #define MESSAGE_DATA_MAIL					0x03, 0x06
+#define MESSAGE_DATA_RECEIVED				0x03, 0x04
 #define MESSAGE_DATA_NET          			0x07, 0x03
 
 #define MESSAGE_NETWORK_GET_STATISTICS		0x07, 0x03
 #define MESSAGE_NETWORK_PING				0x07, 0x09
+#define MESSAGE_NETWORK_STATISTICS			0x07, 0x04
+#define MESSAGE_NETWORK_PONG				0x07, 0x0a
 
 #define MESSAGE_SETTINGS_SET_CREDENTIALS	0x08, 0x03
 #define MESSAGE_SETTINGS_BECOME_ROOT		0x08, 0x04
@@ -150,6 +163,7 @@ public:
 	// Constructor/Destructor
 	MiraOneMessage();
 	MiraOneMessage(uint8_t a, uint8_t b);
+	MiraOneMessage(const MiraOneMessage& other);
 	~MiraOneMessage();
 
 	// Static message factories
@@ -183,19 +197,35 @@ public:
 	uint8_t getMessageIndex();
 	uint8_t getDataSize();
 	uint8_t* getData();
+	bool isDataSend();
+	bool isError();
+	uint8_t getErrorCode();
+	uint16_t getFrameSize();
+	bool getEUI64Address(IEEE_EUI64& address);
+	uint32_t getRxStartMicros();
+	uint32_t getRxEndMicros();
 
 	// Property setters
 	void setData(const uint8_t* data, uint8_t length);
+	void setAddress(const uint8_t* address, uint8_t length);
 	void setMessageIndex(uint8_t index);
+	void setRxTime(uint32_t startMicros, uint32_t endMicros);
 
 	// Message handling
-	bool write(Stream* stream, uint8_t messageId, Logger* logger);
+	bool write(Print* output, uint8_t messageId, Logger* logger);
 	bool read(Stream* stream, Logger* logger);
 	void dumpToLog(Logger* logger);
 
-	// CRC - Not used here
+	// CRC
 	static uint16_t crc16Kermit(char *data, uint16_t len);
 	static uint16_t addToCrc(uint16_t& currentValue, uint8_t value);
+	static uint16_t updateCrc(uint16_t currentValue, const uint8_t* data, size_t length);
+
+	// Framing
+	static size_t findSpecial(const uint8_t* data, size_t length);
+	static size_t writeEscaped(Print* output, const uint8_t* data, size_t length);
+	static size_t getEscapedSize(const uint8_t* data, size_t length);
+	void setFrame(const uint8_t* frame, uint16_t length);
 
 	// Logging
 	static void setLogger(Logger* logger);
@@ -208,10 +238,17 @@ private:
 	uint8_t* _address = nullptr;
 	uint8_t* _data = nullptr;
 	uint16_t _crc = 0;
+	uint32_t _rxStartMicros = 0;
+	uint32_t _rxEndMicros = 0;
+	MiraOneMessage* _next = nullptr;
+
+	friend class MiraTxScheduler;
+	friend class MiraOne;
 
 	// Private functions
-	void writeSTC(Stream* stream, Logger* logger);
-	void writeEscapedData(Stream* stream, uint8_t data, uint16_t& crc, Logger* logger);
+	MiraOneMessage& operator=(const MiraOneMessage& other);
+	void takeFrom(MiraOneMessage* other);
+	uint8_t getAddressSize();
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,12 @@
 //
 // MiraOnePayloadv2 can be used where the address of the sending node doesn't matter.
 //
+// MiraOnePayloadv3 adds a per sender sequence number to the v1 payload. A receiving MiraOne
+// with a duplicate filter set uses it to drop retransmitted and re-routed copies.
+//
+// MiraOnePayloadv4 adds the time the message was sent to the v3 payload, which a gateway
+// uses to estimate the one-way latency through the mesh.
+//
 // 
 //---------------------------------------------------------------------------------------------
 #ifndef __M2M_MIRAONEPAYLOAD_h__
@@ -64,4 +70,39 @@ struct __attribute__((packed)) MiraOnePayloadv2
 	}
 };
 
+// ---------------------------------------------------------------------------------------------
+// Version 3
+// This payload contains the MiraOne node miraAddress and a sequence number, which the
+// sending node increments for every new message and starts at 0 after a restart
+struct __attribute__((packed)) MiraOnePayloadv3
+{
+	uint8_t payloadVersion = 3;
+	IEEE_EUI64 miraAddress;
+	uint16_t sequence;
+	uint8_t dataLength;
+	uint8_t data[];
+	uint8_t getLength() 
+	{ 
+		return sizeof(MiraOnePayloadv3) + dataLength; 
+	}
+};
+
+// ---------------------------------------------------------------------------------------------
+// Version 4
+// This payload adds a send timestamp to the v3 payload, in microseconds of a clock the
+// sending node shares with the gateway
+struct __attribute__((packed)) MiraOnePayloadv4
+{
+	uint8_t payloadVersion = 4;
+	IEEE_EUI64 miraAddress;
+	uint16_t sequence;
+	uint32_t timestamp;
+	uint8_t dataLength;
+	uint8_t data[];
+	uint8_t getLength()
+	{
+		return sizeof(MiraOnePayloadv4) + dataLength;
+	}
+};
+
 #endif
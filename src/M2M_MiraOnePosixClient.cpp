@@ -0,0 +1,230 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOnePosixClient.h"
+
+#ifdef MIRA_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL	0		// macOS, SIGPIPE is ignored per socket instead
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraPosixClient::MiraPosixClient()
+{
+}
+
+MiraPosixClient::~MiraPosixClient()
+{
+	stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Client
+//
+int MiraPosixClient::connect(IPAddress ip, uint16_t port)
+{
+	char host[16];
+	snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+	return connect(host, port);
+}
+
+int MiraPosixClient::connect(const char* host, uint16_t port)
+{
+	stop();
+	char service[6];
+	snprintf(service, sizeof(service), "%u", port);
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* addresses;
+	if (getaddrinfo(host, service, &hints, &addresses) != 0)
+	{
+		return 0;
+	}
+	for (struct addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+	{
+		int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (fd < 0)
+		{
+			continue;
+		}
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+		int noSignal = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+		if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+		{
+			int enable = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			_fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	freeaddrinfo(addresses);
+	return _fd >= 0 ? 1 : 0;
+}
+
+size_t MiraPosixClient::write(uint8_t data)
+{
+	return write(&data, 1);
+}
+
+size_t MiraPosixClient::write(const uint8_t* buffer, size_t size)
+{
+	size_t written = 0;
+	while (written < size && _fd >= 0)
+	{
+		ssize_t result = send(_fd, buffer + written, size - written, MSG_NOSIGNAL);
+		if (result > 0)
+		{
+			written += result;
+			continue;
+		}
+		if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			break;
+		}
+		struct pollfd descriptor = { _fd, POLLOUT, 0 };
+		poll(&descriptor, 1, 100);
+	}
+	return written;
+}
+
+int MiraPosixClient::available()
+{
+	if (_rxTail == _rxHead)
+	{
+		fill();
+	}
+	return static_cast<int>(_rxTail - _rxHead);
+}
+
+int MiraPosixClient::read()
+{
+	if (_rxTail == _rxHead && fill() == 0)
+	{
+		return -1;
+	}
+	return _rxBuffer[_rxHead++];
+}
+
+int MiraPosixClient::read(uint8_t* buffer, size_t size)
+{
+	if (_rxTail == _rxHead && fill() == 0)
+	{
+		return -1;
+	}
+	size_t count = _rxTail - _rxHead;
+	if (count > size)
+	{
+		count = size;
+	}
+	memcpy(buffer, &_rxBuffer[_rxHead], count);
+	_rxHead += count;
+	return static_cast<int>(count);
+}
+
+int MiraPosixClient::peek()
+{
+	if (_rxTail == _rxHead && fill() == 0)
+	{
+		return -1;
+	}
+	return _rxBuffer[_rxHead];
+}
+
+void MiraPosixClient::flush()
+{
+	// Writes go straight to the socket
+}
+
+void MiraPosixClient::stop()
+{
+	if (_fd >= 0)
+	{
+		close(_fd);
+		_fd = -1;
+	}
+	_eof = false;
+	_rxHead = 0;
+	_rxTail = 0;
+}
+
+uint8_t MiraPosixClient::connected()
+{
+	// Still connected while unread data remains, as the Arduino clients do
+	if (_rxTail != _rxHead)
+	{
+		return 1;
+	}
+	fill();
+	return _fd >= 0 && (!_eof || _rxTail != _rxHead) ? 1 : 0;
+}
+
+MiraPosixClient::operator bool()
+{
+	return _fd >= 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+size_t MiraPosixClient::fill()
+{
+	_rxHead = 0;
+	_rxTail = 0;
+	if (_fd < 0 || _eof)
+	{
+		return 0;
+	}
+	ssize_t result;
+	do
+	{
+		result = recv(_fd, _rxBuffer, sizeof(_rxBuffer), 0);
+	}
+	while (result < 0 && errno == EINTR);
+	if (result == 0 || (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+	{
+		_eof = true;
+		return 0;
+	}
+	if (result < 0)
+	{
+		return 0;
+	}
+	_rxTail = result;
+	return result;
+}
+
+#endif
@@ -0,0 +1,77 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Arduino Client over a POSIX TCP socket, so MiraHttpUplink can be used on Linux gateways
+// and tested against a local HTTP server.
+//
+// connect() blocks like the Arduino network clients do, after that the socket is
+// non-blocking and available() and read() never wait.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEPOSIXCLIENT_h__
+#define __M2M_MIRAONEPOSIXCLIENT_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include <Client.h>
+#include "M2M_MiraOneMessage.h"
+
+#ifdef MIRA_HOST_BUILD
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_POSIX_CLIENT_BUFFER_SIZE	1024
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraPosixClient : public Client
+{
+public:
+	// Constructor/Destructor
+	MiraPosixClient();
+	~MiraPosixClient();
+
+	// Client
+	int connect(IPAddress ip, uint16_t port) override;
+	int connect(const char* host, uint16_t port) override;
+	size_t write(uint8_t data) override;
+	size_t write(const uint8_t* buffer, size_t size) override;
+	int available() override;
+	int read() override;
+	int read(uint8_t* buffer, size_t size) override;
+	int peek() override;
+	void flush() override;
+	void stop() override;
+	uint8_t connected() override;
+	operator bool() override;
+
+	using Print::write;
+
+private:
+	int _fd = -1;
+	bool _eof = false;
+	uint8_t _rxBuffer[MIRA_POSIX_CLIENT_BUFFER_SIZE];
+	size_t _rxHead = 0;
+	size_t _rxTail = 0;
+
+	// Private functions
+	size_t fill();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,279 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOnePosixSerial.h"
+
+#ifdef MIRA_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraPosixSerial::MiraPosixSerial()
+{
+}
+
+MiraPosixSerial::~MiraPosixSerial()
+{
+	end();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Infrastructure
+//
+bool MiraPosixSerial::begin(const char* device, uint32_t baudRate)
+{
+	end();
+	int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (!configure(fd, baudRate))
+	{
+		close(fd);
+		return false;
+	}
+	return attach(fd);
+}
+
+bool MiraPosixSerial::beginPty(char* peerName, size_t length)
+{
+	end();
+	int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+	const char* name = nullptr;
+	if (grantpt(fd) == 0 && unlockpt(fd) == 0)
+	{
+		name = ptsname(fd);
+	}
+	if (name == nullptr || strlen(name) >= length || !configure(fd, 0))
+	{
+		close(fd);
+		return false;
+	}
+	strcpy(peerName, name);
+	return attach(fd);
+}
+
+bool MiraPosixSerial::attach(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		return false;
+	}
+	_fd = fd;
+	_rxHead = 0;
+	_rxTail = 0;
+	return true;
+}
+
+void MiraPosixSerial::end()
+{
+	if (_fd >= 0)
+	{
+		close(_fd);
+		_fd = -1;
+	}
+	_rxHead = 0;
+	_rxTail = 0;
+}
+
+int MiraPosixSerial::getFd()
+{
+	return _fd;
+}
+
+bool MiraPosixSerial::waitReadable(int timeoutMillis)
+{
+	if (_rxTail != _rxHead)
+	{
+		return true;
+	}
+	struct pollfd descriptor = { _fd, POLLIN, 0 };
+	return poll(&descriptor, 1, timeoutMillis) > 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Stream
+//
+int MiraPosixSerial::available()
+{
+	if (_rxTail == _rxHead)
+	{
+		fill();
+	}
+	return static_cast<int>(_rxTail - _rxHead);
+}
+
+int MiraPosixSerial::read()
+{
+	if (_rxTail == _rxHead && fill() == 0)
+	{
+		return -1;
+	}
+	return _rxBuffer[_rxHead++];
+}
+
+int MiraPosixSerial::peek()
+{
+	if (_rxTail == _rxHead && fill() == 0)
+	{
+		return -1;
+	}
+	return _rxBuffer[_rxHead];
+}
+
+size_t MiraPosixSerial::readAvailable(uint8_t* buffer, size_t length)
+{
+	if (_rxTail == _rxHead)
+	{
+		fill();
+	}
+	size_t count = _rxTail - _rxHead;
+	if (count > length)
+	{
+		count = length;
+	}
+	memcpy(buffer, &_rxBuffer[_rxHead], count);
+	_rxHead += count;
+	return count;
+}
+
+size_t MiraPosixSerial::write(uint8_t data)
+{
+	return write(&data, 1);
+}
+
+size_t MiraPosixSerial::write(const uint8_t* buffer, size_t size)
+{
+	// Never waits, a full driver queue gives a short count and the caller keeps the rest
+	size_t written = 0;
+	while (written < size && _fd >= 0)
+	{
+		ssize_t result = ::write(_fd, buffer + written, size - written);
+		if (result > 0)
+		{
+			written += result;
+		}
+		else if (result == 0 || errno != EINTR)
+		{
+			break;
+		}
+	}
+	return written;
+}
+
+int MiraPosixSerial::availableForWrite()
+{
+	int queued = 0;
+	if (_fd < 0)
+	{
+		return 0;
+	}
+#ifdef TIOCOUTQ
+	if (ioctl(_fd, TIOCOUTQ, &queued) < 0)
+	{
+		queued = 0;
+	}
+#endif
+	return queued >= MIRA_POSIX_TX_QUEUE_SIZE ? 0 : MIRA_POSIX_TX_QUEUE_SIZE - queued;
+}
+
+void MiraPosixSerial::flush()
+{
+	if (_fd >= 0)
+	{
+		tcdrain(_fd);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+size_t MiraPosixSerial::fill()
+{
+	// Only called with an empty buffer, so the whole buffer is available to one read()
+	_rxHead = 0;
+	_rxTail = 0;
+	if (_fd < 0)
+	{
+		return 0;
+	}
+	ssize_t result;
+	do
+	{
+		result = ::read(_fd, _rxBuffer, sizeof(_rxBuffer));
+	}
+	while (result < 0 && errno == EINTR);
+	if (result <= 0)
+	{
+		return 0;
+	}
+	_rxTail = result;
+	return result;
+}
+
+bool MiraPosixSerial::configure(int fd, uint32_t baudRate)
+{
+	struct termios options;
+	if (tcgetattr(fd, &options) < 0)
+	{
+		return false;
+	}
+	cfmakeraw(&options);
+	options.c_cflag |= CLOCAL | CREAD;
+	options.c_cc[VMIN] = 0;
+	options.c_cc[VTIME] = 0;
+	if (baudRate != 0)
+	{
+		speed_t speed;
+		switch (baudRate)
+		{
+			case 9600: speed = B9600; break;
+			case 19200: speed = B19200; break;
+			case 38400: speed = B38400; break;
+			case 57600: speed = B57600; break;
+			case 115200: speed = B115200; break;
+			case 230400: speed = B230400; break;
+#ifdef B460800
+			case 460800: speed = B460800; break;
+#endif
+#ifdef B921600
+			case 921600: speed = B921600; break;
+#endif
+			default:
+				return false;
+		}
+		cfsetispeed(&options, speed);
+		cfsetospeed(&options, speed);
+	}
+	return tcsetattr(fd, TCSANOW, &options) == 0;
+}
+
+#endif
@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Stream implementation over a POSIX serial port, for running the library on Linux gateways.
+//
+// The port is opened non-blocking. Reads are done in large batches into a user space buffer,
+// so available(), read() and peek() only make a system call when the buffer is empty.
+// write(buffer, size) is passed on as one write() call and does not wait. When the driver
+// queue is full it returns a short count, MiraOne keeps the rest in its transmit ring.
+//
+// beginPty() opens the master side of a pseudo terminal and returns the name of the slave
+// side. A second instance opened on that name with begin() gives a connected pair of streams
+// for testing without hardware.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEPOSIXSERIAL_h__
+#define __M2M_MIRAONEPOSIXSERIAL_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include <Stream.h>
+#include "M2M_MiraOneMessage.h"
+
+#ifdef MIRA_HOST_BUILD
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_POSIX_RX_BUFFER_SIZE
+#define MIRA_POSIX_RX_BUFFER_SIZE	4096
+#endif
+#define MIRA_POSIX_TX_QUEUE_SIZE	4096	// Assumed size of the driver output queue
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraPosixSerial : public Stream
+{
+public:
+	// Constructor/Destructor
+	MiraPosixSerial();
+	~MiraPosixSerial();
+
+	// Infrastructure
+	bool begin(const char* device, uint32_t baudRate);
+	bool beginPty(char* peerName, size_t length);
+	bool attach(int fd);
+	void end();
+	int getFd();
+	bool waitReadable(int timeoutMillis);
+
+	// Stream
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t readAvailable(uint8_t* buffer, size_t length);
+	size_t write(uint8_t data) override;
+	size_t write(const uint8_t* buffer, size_t size) override;
+	int availableForWrite() override;
+	void flush() override;
+
+	using Print::write;
+
+private:
+	int _fd = -1;
+	uint8_t _rxBuffer[MIRA_POSIX_RX_BUFFER_SIZE];
+	size_t _rxHead = 0;
+	size_t _rxTail = 0;
+
+	// Private functions
+	size_t fill();
+	bool configure(int fd, uint32_t baudRate);
+};
+
+#endif
+
+#endif
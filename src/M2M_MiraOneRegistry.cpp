@@ -0,0 +1,383 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneRegistry.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Tables
+//
+static const char className01[] PROGMEM = "GENERAL_MESSAGES";
+static const char className03[] PROGMEM = "DATA_MESSAGES";
+static const char className04[] PROGMEM = "FWUP_MESSAGES";
+static const char className07[] PROGMEM = "NETSTAT_MESSAGES";
+static const char className08[] PROGMEM = "SETTINGS_MESSAGES";
+
+static const char typeAck[] PROGMEM = "ACK";
+static const char typeError[] PROGMEM = "ERROR";
+static const char typeGetVersion[] PROGMEM = "GET_VERSION";
+static const char typeGetEUI64Info[] PROGMEM = "GET_EUI64INFO";
+static const char typeDataSend[] PROGMEM = "DATA_SEND";
+static const char typeDataReceived[] PROGMEM = "DATA_RECEIVED";
+static const char typeSleepyDataReceived[] PROGMEM = "SLEEPY_DATA_RECEIVED";
+static const char typeDataMail[] PROGMEM = "DATA_MAIL";
+static const char typeSleepyDataMail[] PROGMEM = "SLEEPY_DATA_MAIL";
+static const char typeFwupOpenSession[] PROGMEM = "FWUP_OPEN_SESSION";
+static const char typeFwupCloseSession[] PROGMEM = "FWUP_CLOSE_SESSION";
+static const char typeFwupSubscribe[] PROGMEM = "FWUP_SUBSCRIBE";
+static const char typeFwupStatusRequest[] PROGMEM = "FWUP_STATUS_REQUEST";
+static const char typeFwupStatus[] PROGMEM = "FWUP_STATUS";
+static const char typeFwupDataRequest[] PROGMEM = "FWUP_DATA_REQUEST";
+static const char typeFwupData[] PROGMEM = "FWUP_DATA";
+static const char typeFwupRollbackRequest[] PROGMEM = "FWUP_ROLLBACK_REQUEST";
+static const char typeNetworkGetStatistics[] PROGMEM = "NETWORK_GET_STATISTICS";
+static const char typeNetworkStatistics[] PROGMEM = "NETWORK_STATISTICS";
+static const char typeNetworkPing[] PROGMEM = "NETWORK_PING";
+static const char typeNetworkPong[] PROGMEM = "NETWORK_PONG";
+static const char typeSetCredentials[] PROGMEM = "SETTINGS_SET_CREDENTIALS";
+static const char typeBecomeRoot[] PROGMEM = "SETTINGS_BECOME_ROOT";
+static const char typeSetAntenna[] PROGMEM = "SETTINGS_SET_ANTENNA";
+static const char typeSetName[] PROGMEM = "SETTINGS_SET_NAME";
+static const char typeCommit[] PROGMEM = "SETTINGS_COMMIT";
+
+#define MIRA_TYPE(name, request, response) { name, MiraPayloadLayout::request, MiraPayloadLayout::response }
+#define MIRA_TYPE_UNKNOWN { nullptr, MiraPayloadLayout::none, MiraPayloadLayout::none }
+
+// Every type from 0 up to the highest known one of each class, indexed by type
+static const MiraMessageInfo messages[] PROGMEM =
+{
+	// GENERAL_MESSAGES, index 0
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeAck, none, none),
+	MIRA_TYPE(typeError, errorCode, errorCode),
+	MIRA_TYPE(typeGetVersion, none, version),
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeGetEUI64Info, none, eui64),
+	// DATA_MESSAGES, index 10
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeAck, none, none),
+	MIRA_TYPE(typeError, errorCode, errorCode),
+	MIRA_TYPE(typeDataSend, raw, none),
+	MIRA_TYPE(typeDataReceived, raw, raw),
+	MIRA_TYPE(typeSleepyDataReceived, raw, raw),
+	MIRA_TYPE(typeDataMail, none, raw),
+	MIRA_TYPE(typeSleepyDataMail, raw, raw),
+	// FWUP_MESSAGES, index 18
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeAck, none, none),
+	MIRA_TYPE(typeError, errorCode, errorCode),
+	MIRA_TYPE(typeFwupOpenSession, raw, raw),
+	MIRA_TYPE(typeFwupCloseSession, raw, raw),
+	MIRA_TYPE(typeFwupSubscribe, raw, raw),
+	MIRA_TYPE(typeFwupStatusRequest, raw, raw),
+	MIRA_TYPE(typeFwupStatus, raw, raw),
+	MIRA_TYPE(typeFwupDataRequest, raw, raw),
+	MIRA_TYPE(typeFwupData, raw, raw),
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeFwupRollbackRequest, raw, raw),
+	// NETSTAT_MESSAGES, index 32
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeAck, none, none),
+	MIRA_TYPE(typeError, errorCode, errorCode),
+	MIRA_TYPE(typeNetworkGetStatistics, interval, none),
+	MIRA_TYPE(typeNetworkStatistics, statistics, statistics),
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeNetworkPing, raw, raw),
+	MIRA_TYPE(typeNetworkPong, raw, raw),
+	// SETTINGS_MESSAGES, index 43
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeAck, none, none),
+	MIRA_TYPE(typeError, errorCode, errorCode),
+	MIRA_TYPE(typeSetCredentials, credentials, none),
+	MIRA_TYPE(typeBecomeRoot, none, none),
+	MIRA_TYPE(typeSetAntenna, antenna, none),
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE_UNKNOWN,
+	MIRA_TYPE(typeSetName, name, none),
+	MIRA_TYPE(typeCommit, none, none)
+	// 54 entries
+};
+
+static const MiraClassInfo classes[MIRA_REGISTRY_CLASSES] PROGMEM =
+{
+	{ nullptr, 0, 0 },
+	{ className01, 0, 10 },
+	{ nullptr, 0, 0 },
+	{ className03, 10, 8 },
+	{ className04, 18, 14 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ className07, 32, 11 },
+	{ className08, 43, 11 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 },
+	{ nullptr, 0, 0 }
+};
+
+static_assert(sizeof(messages) / sizeof(messages[0]) == 54, "Class table offsets do not match the message table");
+
+static const char hexDigits[] PROGMEM = "0123456789abcdef";
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Lookup
+//
+bool MiraRegistry::getMessageInfo(uint8_t messageClass, uint8_t messageType, MiraMessageInfo& info)
+{
+	if (messageClass >= MIRA_REGISTRY_CLASSES)
+	{
+		return false;
+	}
+	MiraClassInfo classInfo;
+	memcpy_P(&classInfo, &classes[messageClass], sizeof(classInfo));
+	if (messageType >= classInfo.count)
+	{
+		return false;
+	}
+	memcpy_P(&info, &messages[classInfo.first + messageType], sizeof(info));
+	return info.name != nullptr;
+}
+
+MiraPayloadLayout MiraRegistry::getLayout(uint8_t messageClass, uint8_t messageType, bool response)
+{
+	// Unknown messages are printed as hex
+	MiraMessageInfo info;
+	if (!getMessageInfo(messageClass, messageType, info))
+	{
+		return MiraPayloadLayout::raw;
+	}
+	return response ? info.response : info.request;
+}
+
+const __FlashStringHelper* MiraRegistry::getClassName(uint8_t messageClass)
+{
+	if (messageClass >= MIRA_REGISTRY_CLASSES)
+	{
+		return nullptr;
+	}
+	MiraClassInfo classInfo;
+	memcpy_P(&classInfo, &classes[messageClass], sizeof(classInfo));
+	return reinterpret_cast<const __FlashStringHelper*>(classInfo.name);
+}
+
+const __FlashStringHelper* MiraRegistry::getTypeName(uint8_t messageClass, uint8_t messageType)
+{
+	MiraMessageInfo info;
+	if (!getMessageInfo(messageClass, messageType, info))
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<const __FlashStringHelper*>(info.name);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Printing
+//
+size_t MiraRegistry::printClassName(Print* output, uint8_t messageClass)
+{
+	const __FlashStringHelper* name = getClassName(messageClass);
+	return name != nullptr ? output->print(name) : printUnknown(output, messageClass);
+}
+
+size_t MiraRegistry::printTypeName(Print* output, uint8_t messageClass, uint8_t messageType)
+{
+	const __FlashStringHelper* name = getTypeName(messageClass, messageType);
+	return name != nullptr ? output->print(name) : printUnknown(output, messageType);
+}
+
+size_t MiraRegistry::printPayload(Print* output, MiraPayloadLayout layout, const uint8_t* data, uint8_t size)
+{
+	// Payloads shorter than their layout, or not matching it, are printed as hex
+	size_t written = 0;
+	switch (layout)
+	{
+		case MiraPayloadLayout::errorCode:
+			if (size < 1)
+			{
+				break;
+			}
+			written += output->print(F("error 0x"));
+			return written + printHex(output, data, 1, false);
+		case MiraPayloadLayout::version:
+			if (size < 2)
+			{
+				break;
+			}
+			written += output->print(F("version "));
+			written += output->print(data[0]);
+			written += output->print('.');
+			return written + output->print(data[1]);
+		case MiraPayloadLayout::eui64:
+			if (size < sizeof(IEEE_EUI64))
+			{
+				break;
+			}
+			written += output->print(F("address "));
+			return written + printHex(output, data, sizeof(IEEE_EUI64), false);
+		case MiraPayloadLayout::interval:
+			if (size < 1)
+			{
+				break;
+			}
+			written += output->print(F("interval "));
+			return written + output->print(data[0]);
+		case MiraPayloadLayout::credentials:
+			if (size < 2)
+			{
+				break;
+			}
+			written += output->print(F("network id "));
+			return written + output->print(static_cast<unsigned int>(data[0] | data[1] << 8));
+		case MiraPayloadLayout::antenna:
+			if (size < 1 || data[0] > static_cast<uint8_t>(MiraAntenna::external))
+			{
+				break;
+			}
+			written += output->print(F("antenna "));
+			return written + output->print(data[0] == static_cast<uint8_t>(MiraAntenna::internal) ? F("internal") : F("external"));
+		case MiraPayloadLayout::name:
+			written += output->print(F("name \""));
+			for (uint8_t i = 0; i < size; i++)
+			{
+				written += output->print(data[i] >= 0x20 && data[i] < 0x7f ? static_cast<char>(data[i]) : '.');
+			}
+			return written + output->print('"');
+		case MiraPayloadLayout::statistics:
+			if (size < 19)
+			{
+				break;
+			}
+			written += output->print(F("node "));
+			written += printHex(output, data, 8, false);
+			written += output->print(F(" parent "));
+			written += printHex(output, &data[8], 8, false);
+			written += output->print(F(" os "));
+			written += output->print(data[16]);
+			written += output->print('.');
+			written += output->print(data[17]);
+			written += output->print(F(" link "));
+			written += output->print(data[18]);
+			if (size > 19)
+			{
+				written += output->print(F(" errors "));
+				written += printHex(output, &data[19], size - 19, true);
+			}
+			return written;
+		default:
+			break;
+	}
+	return written + printHex(output, data, size, true);
+}
+
+size_t MiraRegistry::printFrame(Print* output, const MiraFrameView& frame)
+{
+	// One line per frame, class and type by name, then the index, address and payload
+	size_t written = printClassName(output, frame.getMessageClass());
+	written += output->print(' ');
+	written += printTypeName(output, frame.getMessageClass(), frame.getMessageType());
+	if (frame.isResponse())
+	{
+		written += output->print(F(" response"));
+	}
+	uint8_t index = frame.getMessageIndex();
+	written += output->print(F(" index 0x"));
+	written += printHex(output, &index, 1, false);
+	IEEE_EUI64 address;
+	if (frame.getEUI64Address(address))
+	{
+		written += output->print(F(" address "));
+		written += printHex(output, address.data, sizeof(address.data), false);
+	}
+	written += output->print(F(", "));
+	written += output->print(frame.getDataSize());
+	written += output->print(F(" bytes"));
+	if (frame.getDataSize() > 0)
+	{
+		written += output->print(F(": "));
+		MiraPayloadLayout layout = getLayout(frame.getMessageClass(), frame.getMessageType(), frame.isResponse());
+		written += printPayload(output, layout, frame.getData(), frame.getDataSize());
+	}
+	return written + output->println();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+size_t MiraRegistry::printHex(Print* output, const uint8_t* data, uint8_t size, bool spaced)
+{
+	size_t written = 0;
+	for (uint8_t i = 0; i < size; i++)
+	{
+		if (spaced && i > 0)
+		{
+			written += output->write(' ');
+		}
+		written += output->write(pgm_read_byte(&hexDigits[data[i] >> 4]));
+		written += output->write(pgm_read_byte(&hexDigits[data[i] & 0x0f]));
+	}
+	return written;
+}
+
+size_t MiraRegistry::printUnknown(Print* output, uint8_t value)
+{
+	size_t written = output->print(F("Unknown: 0x"));
+	return written + printHex(output, &value, 1, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// MiraTextBuffer
+//
+MiraTextBuffer::MiraTextBuffer()
+{
+	clear();
+}
+
+size_t MiraTextBuffer::write(uint8_t value)
+{
+	if (_length >= sizeof(_text) - 1)
+	{
+		return 0;
+	}
+	_text[_length++] = static_cast<char>(value);
+	_text[_length] = '\0';
+	return 1;
+}
+
+const char* MiraTextBuffer::c_str()
+{
+	return _text;
+}
+
+void MiraTextBuffer::clear()
+{
+	_length = 0;
+	_text[0] = '\0';
+}
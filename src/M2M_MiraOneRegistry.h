@@ -0,0 +1,123 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Names and payload layouts of the known message classes and types.
+//
+// Everything is kept in two constant tables in PROGMEM. The class table gives the class
+// name and where the types of the class start in the message table, which holds every type
+// from 0 up to the highest known one. Looking up a frame is two indexed reads, whatever the
+// class and type.
+//
+// MiraOneMessage::dumpToLog() uses the tables for its trace, printFrame() prints a frame on
+// one line, for decoding a capture of the UART traffic.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONEREGISTRY_h__
+#define __M2M_MIRAONEREGISTRY_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+#include "M2M_MiraOneDispatch.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_REGISTRY_CLASSES		16		// Message class is the low nibble of the header
+
+#ifndef MIRA_REGISTRY_TEXT_SIZE
+#ifdef MIRA_HOST_BUILD
+#define MIRA_REGISTRY_TEXT_SIZE		160		// Characters kept by MiraTextBuffer
+#else
+#define MIRA_REGISTRY_TEXT_SIZE		80
+#endif
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraPayloadLayout: uint8_t
+{
+	none = 0,			// No payload expected
+	raw = 1,			// Application data, printed as hex
+	errorCode = 2,
+	version = 3,		// Major, minor
+	eui64 = 4,
+	interval = 5,		// Statistics interval
+	credentials = 6,	// Network id, the AES key is not printed
+	antenna = 7,
+	name = 8,
+	statistics = 9		// Node, parent, OS version, link quality, channel error rates
+};
+
+struct MiraMessageInfo
+{
+	const char* name;				// In PROGMEM, nullptr for unknown types
+	MiraPayloadLayout request;
+	MiraPayloadLayout response;
+};
+
+struct MiraClassInfo
+{
+	const char* name;				// In PROGMEM, nullptr for unknown classes
+	uint8_t first;					// Message table index of type 0
+	uint8_t count;					// Types in the message table
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraRegistry
+{
+public:
+	// Lookup
+	static bool getMessageInfo(uint8_t messageClass, uint8_t messageType, MiraMessageInfo& info);
+	static MiraPayloadLayout getLayout(uint8_t messageClass, uint8_t messageType, bool response);
+	static const __FlashStringHelper* getClassName(uint8_t messageClass);
+	static const __FlashStringHelper* getTypeName(uint8_t messageClass, uint8_t messageType);
+
+	// Printing
+	static size_t printClassName(Print* output, uint8_t messageClass);
+	static size_t printTypeName(Print* output, uint8_t messageClass, uint8_t messageType);
+	static size_t printPayload(Print* output, MiraPayloadLayout layout, const uint8_t* data, uint8_t size);
+	static size_t printFrame(Print* output, const MiraFrameView& frame);
+
+private:
+	static size_t printHex(Print* output, const uint8_t* data, uint8_t size, bool spaced);
+	static size_t printUnknown(Print* output, uint8_t value);
+};
+
+// Print target for the logger, which takes format strings and not a Print. Text past the
+// end of the buffer is dropped.
+class MiraTextBuffer : public Print
+{
+public:
+	// Constructor
+	MiraTextBuffer();
+
+	// Print
+	size_t write(uint8_t value) override;
+
+	// Buffer
+	const char* c_str();
+	void clear();
+
+private:
+	char _text[MIRA_REGISTRY_TEXT_SIZE];
+	uint8_t _length;
+};
+
+#endif
@@ -0,0 +1,129 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneRtt.h"
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraRttEstimator::MiraRttEstimator()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Estimation
+//
+void MiraRttEstimator::addSample(uint32_t rtt)
+{
+	if (_samples == 0)
+	{
+		_srtt = rtt << 3;
+		_rttvar = rtt << 1;
+	}
+	else
+	{
+		int32_t delta = static_cast<int32_t>(rtt) - static_cast<int32_t>(_srtt >> 3);
+		_srtt += delta;
+		if (delta < 0)
+		{
+			delta = -delta;
+		}
+		delta -= static_cast<int32_t>(_rttvar >> 2);
+		_rttvar += delta;
+	}
+	_samples++;
+	_backoff = 0;
+}
+
+void MiraRttEstimator::backOff()
+{
+	if (_backoff < MIRA_RTT_MAX_BACKOFF)
+	{
+		_backoff++;
+	}
+}
+
+void MiraRttEstimator::reset()
+{
+	_srtt = 0;
+	_rttvar = 0;
+	_samples = 0;
+	_backoff = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property setters
+//
+void MiraRttEstimator::setLimits(uint32_t floor, uint32_t ceiling)
+{
+	_floor = floor;
+	_ceiling = ceiling < floor ? floor : ceiling;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint32_t MiraRttEstimator::getTimeout()
+{
+	if (_samples == 0)
+	{
+		return _ceiling;
+	}
+	uint32_t timeout = ((_srtt >> 3) + (_rttvar > 0 ? _rttvar : 1)) << _backoff;
+	if (timeout < _floor)
+	{
+		timeout = _floor;
+	}
+	if (timeout > _ceiling)
+	{
+		timeout = _ceiling;
+	}
+	return timeout;
+}
+
+uint32_t MiraRttEstimator::getSmoothedRtt()
+{
+	return _srtt >> 3;
+}
+
+uint32_t MiraRttEstimator::getDeviation()
+{
+	return _rttvar >> 2;
+}
+
+uint32_t MiraRttEstimator::getSampleCount()
+{
+	return _samples;
+}
+
+MiraRttClass MiraRttEstimator::getRttClass(uint8_t messageClass, bool reply)
+{
+	// The ACK always comes from the local module, only network replies cross the mesh
+	switch (messageClass)
+	{
+		case MIRA_MESSAGE_CLASS_DATAMESSAGE:
+			return MiraRttClass::data;
+		case MIRA_MESSAGE_CLASS_SETTINGSMESSAGE:
+			return MiraRttClass::settings;
+		case MIRA_MESSAGE_CLASS_NETSTATMESSAGE:
+			return reply ? MiraRttClass::mesh : MiraRttClass::command;
+		default:
+			return MiraRttClass::command;
+	}
+}
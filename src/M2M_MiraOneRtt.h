@@ -0,0 +1,108 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Round trip time estimation for command timeouts.
+//
+// Each command class keeps a smoothed RTT and mean deviation, updated as in TCP
+// (Jacobson/Karels) with integer arithmetic: gain 1/8 for the RTT and 1/4 for the deviation.
+// The timeout is RTT + 4 * deviation, clamped to the floor and ceiling of the class. Until
+// the first sample arrives the ceiling is used. A timeout doubles the value until the next
+// sample, so a path that became slower is not timed out over and over.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONERTT_h__
+#define __M2M_MIRAONERTT_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_RTT_CLASS_COUNT		4
+#define MIRA_RTT_MAX_BACKOFF		4		// Timeout doublings without a new sample
+
+#ifndef MIRA_RTT_COMMAND_FLOOR
+#define MIRA_RTT_COMMAND_FLOOR		20		// ms, commands answered by the module itself
+#endif
+#ifndef MIRA_RTT_COMMAND_CEILING
+#define MIRA_RTT_COMMAND_CEILING	1000
+#endif
+#ifndef MIRA_RTT_SETTINGS_FLOOR
+#define MIRA_RTT_SETTINGS_FLOOR		100		// ms, settings may be written to flash
+#endif
+#ifndef MIRA_RTT_SETTINGS_CEILING
+#define MIRA_RTT_SETTINGS_CEILING	2000
+#endif
+#ifndef MIRA_RTT_DATA_FLOOR
+#define MIRA_RTT_DATA_FLOOR			50		// ms, DATA_SEND acknowledgement
+#endif
+#ifndef MIRA_RTT_DATA_CEILING
+#define MIRA_RTT_DATA_CEILING		2000
+#endif
+#ifndef MIRA_RTT_MESH_FLOOR
+#define MIRA_RTT_MESH_FLOOR			200		// ms, replies crossing the mesh network
+#endif
+#ifndef MIRA_RTT_MESH_CEILING
+#define MIRA_RTT_MESH_CEILING		5000
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraRttClass: uint8_t
+{
+	command = 0,		// ACK and replies from the module, device and network commands
+	settings = 1,		// ACK to settings commands
+	data = 2,			// ACK to DATA_SEND
+	mesh = 3			// Replies from other nodes, following the ACK
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraRttEstimator
+{
+public:
+	// Constructor
+	MiraRttEstimator();
+
+	// Estimation
+	void addSample(uint32_t rtt);
+	void backOff();
+	void reset();
+
+	// Property setters
+	void setLimits(uint32_t floor, uint32_t ceiling);
+
+	// Property getters
+	uint32_t getTimeout();
+	uint32_t getSmoothedRtt();
+	uint32_t getDeviation();
+	uint32_t getSampleCount();
+
+	static MiraRttClass getRttClass(uint8_t messageClass, bool reply);
+
+private:
+	uint32_t _srtt = 0;			// Scaled by 8
+	uint32_t _rttvar = 0;		// Scaled by 4
+	uint32_t _floor = MIRA_RTT_COMMAND_FLOOR;
+	uint32_t _ceiling = MIRA_RTT_COMMAND_CEILING;
+	uint32_t _samples = 0;
+	uint8_t _backoff = 0;
+};
+
+#endif
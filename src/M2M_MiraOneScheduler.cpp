@@ -0,0 +1,240 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneScheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraTxScheduler::MiraTxScheduler()
+{
+	memset(_flows, 0, sizeof(_flows));
+	memset(_current, 0, sizeof(_current));
+	memset(_turnStarted, 0, sizeof(_turnStarted));
+	memset(_classCount, 0, sizeof(_classCount));
+}
+
+MiraTxScheduler::~MiraTxScheduler()
+{
+	clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Queue handling
+//
+bool MiraTxScheduler::enqueue(MiraOneMessage* message, MiraTxClass txClass)
+{
+	if (_count >= MIRA_TX_QUEUE_SIZE)
+	{
+		return false;
+	}
+	uint8_t index = static_cast<uint8_t>(txClass);
+	IEEE_EUI64 destination;
+	getDestination(message, destination);
+	MiraTxFlow* flow = findFlow(index, destination);
+	if (flow->count == 0)
+	{
+		flow->destination = destination;
+		flow->head = message;
+	}
+	else
+	{
+		flow->tail->_next = message;
+	}
+	message->_next = nullptr;
+	flow->tail = message;
+	flow->count++;
+	_classCount[index]++;
+	_count++;
+	if (_selected != nullptr && index < _selectedClass)
+	{
+		// A higher priority frame preempts the current selection
+		_selected = nullptr;
+	}
+	return true;
+}
+
+MiraOneMessage* MiraTxScheduler::peek()
+{
+	if (_selected != nullptr)
+	{
+		return _selected->head;
+	}
+	for (uint8_t txClass = 0; txClass < MIRA_TX_CLASS_COUNT; txClass++)
+	{
+		MiraTxFlow* flow = select(txClass);
+		if (flow != nullptr)
+		{
+			_selected = flow;
+			_selectedClass = txClass;
+			return flow->head;
+		}
+	}
+	return nullptr;
+}
+
+MiraOneMessage* MiraTxScheduler::dequeue()
+{
+	MiraOneMessage* result = peek();
+	if (result == nullptr)
+	{
+		return nullptr;
+	}
+	MiraTxFlow* flow = _selected;
+	flow->head = result->_next;
+	flow->deficit -= result->getFrameSize();
+	flow->count--;
+	_classCount[_selectedClass]--;
+	_count--;
+	if (flow->count == 0)
+	{
+		flow->tail = nullptr;
+		flow->deficit = 0;
+		advance(_selectedClass);
+	}
+	_selected = nullptr;
+	result->_next = nullptr;
+	return result;
+}
+
+void MiraTxScheduler::clear()
+{
+	for (uint8_t txClass = 0; txClass < MIRA_TX_CLASS_COUNT; txClass++)
+	{
+		for (uint8_t i = 0; i < MIRA_TX_MAX_FLOWS; i++)
+		{
+			MiraTxFlow* flow = &_flows[txClass][i];
+			while (flow->head != nullptr)
+			{
+				MiraOneMessage* next = flow->head->_next;
+				delete flow->head;
+				flow->head = next;
+			}
+			flow->tail = nullptr;
+			flow->deficit = 0;
+			flow->count = 0;
+		}
+		_classCount[txClass] = 0;
+	}
+	_count = 0;
+	_selected = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint8_t MiraTxScheduler::getCount()
+{
+	return _count;
+}
+
+uint8_t MiraTxScheduler::getCount(MiraTxClass txClass)
+{
+	return _classCount[static_cast<uint8_t>(txClass)];
+}
+
+MiraTxClass MiraTxScheduler::getDefaultClass(MiraOneMessage* message)
+{
+	// Data goes in the interactive class unless the application asks for bulk,
+	// everything else is a command to the module itself
+	if (message->getMessageClass() == MIRA_MESSAGE_CLASS_DATAMESSAGE)
+	{
+		return MiraTxClass::interactive;
+	}
+	return MiraTxClass::control;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraTxFlow* MiraTxScheduler::findFlow(uint8_t txClass, const IEEE_EUI64& destination)
+{
+	MiraTxFlow* empty = nullptr;
+	for (uint8_t i = 0; i < MIRA_TX_MAX_FLOWS; i++)
+	{
+		MiraTxFlow* flow = &_flows[txClass][i];
+		if (flow->count == 0)
+		{
+			if (empty == nullptr)
+			{
+				empty = flow;
+			}
+			continue;
+		}
+		if (memcmp(&flow->destination, &destination, sizeof(IEEE_EUI64)) == 0)
+		{
+			return flow;
+		}
+	}
+	if (empty != nullptr)
+	{
+		return empty;
+	}
+	// More destinations than flows, share a flow picked by address hash
+	uint8_t hash = 0;
+	for (uint8_t i = 0; i < sizeof(IEEE_EUI64); i++)
+	{
+		hash ^= destination.data[i];
+	}
+	return &_flows[txClass][hash % MIRA_TX_MAX_FLOWS];
+}
+
+MiraTxFlow* MiraTxScheduler::select(uint8_t txClass)
+{
+	if (_classCount[txClass] == 0)
+	{
+		return nullptr;
+	}
+	// Terminates as every backlogged flow gains a quantum per round
+	while (true)
+	{
+		MiraTxFlow* flow = &_flows[txClass][_current[txClass]];
+		if (flow->count == 0)
+		{
+			advance(txClass);
+			continue;
+		}
+		if (!_turnStarted[txClass])
+		{
+			flow->deficit += MIRA_TX_QUANTUM;
+			_turnStarted[txClass] = true;
+		}
+		if (flow->head->getFrameSize() <= flow->deficit)
+		{
+			return flow;
+		}
+		advance(txClass);
+	}
+}
+
+void MiraTxScheduler::advance(uint8_t txClass)
+{
+	_current[txClass] = (_current[txClass] + 1) % MIRA_TX_MAX_FLOWS;
+	_turnStarted[txClass] = false;
+}
+
+void MiraTxScheduler::getDestination(MiraOneMessage* message, IEEE_EUI64& destination)
+{
+	if (message->getEUI64Address(destination))
+	{
+		return;
+	}
+	// Root, broadcast and unaddressed frames are keyed on the addressing mode
+	memset(&destination, 0, sizeof(IEEE_EUI64));
+	destination.data[7] = message->getAddressingMode();
+}
@@ -0,0 +1,111 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Outbound frame scheduler.
+//
+// Frames are queued in one of three strict priority classes. A class is only served when all
+// higher priority classes are empty, so control frames always go out before any data.
+// Within a class, frames are kept in one FIFO per destination EUI64 and the FIFOs are
+// served using deficit round-robin, so a single node receiving a large transfer cannot
+// starve the other nodes in the same class.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONESCHEDULER_h__
+#define __M2M_MIRAONESCHEDULER_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#define MIRA_TX_CLASS_COUNT		3
+
+#ifndef MIRA_TX_QUEUE_SIZE
+#define MIRA_TX_QUEUE_SIZE		16		// Max number of queued frames, all classes
+#endif
+
+#ifndef MIRA_TX_MAX_FLOWS
+#ifdef MIRA_HOST_BUILD
+#define MIRA_TX_MAX_FLOWS		8		// Destinations per class served round-robin
+#else
+#define MIRA_TX_MAX_FLOWS		4
+#endif
+#endif
+
+#ifndef MIRA_TX_QUANTUM
+#define MIRA_TX_QUANTUM			64		// Bytes credited to a destination per round
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+enum class MiraTxClass: uint8_t
+{
+	control = 0,
+	interactive = 1,
+	bulk = 2
+};
+
+struct MiraTxFlow
+{
+	IEEE_EUI64 destination;
+	MiraOneMessage* head;
+	MiraOneMessage* tail;
+	uint16_t deficit;
+	uint8_t count;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraTxScheduler
+{
+public:
+	// Constructor/Destructor
+	MiraTxScheduler();
+	~MiraTxScheduler();
+
+	// Queue handling, the scheduler takes ownership of queued messages
+	bool enqueue(MiraOneMessage* message, MiraTxClass txClass);
+	MiraOneMessage* peek();
+	MiraOneMessage* dequeue();
+	void clear();
+
+	// Property getters
+	uint8_t getCount();
+	uint8_t getCount(MiraTxClass txClass);
+
+	static MiraTxClass getDefaultClass(MiraOneMessage* message);
+
+private:
+	MiraTxFlow _flows[MIRA_TX_CLASS_COUNT][MIRA_TX_MAX_FLOWS];
+	uint8_t _current[MIRA_TX_CLASS_COUNT];
+	bool _turnStarted[MIRA_TX_CLASS_COUNT];
+	uint8_t _classCount[MIRA_TX_CLASS_COUNT];
+	uint8_t _count = 0;
+	MiraTxFlow* _selected = nullptr;
+	uint8_t _selectedClass = 0;
+
+	// Private functions
+	MiraTxFlow* findFlow(uint8_t txClass, const IEEE_EUI64& destination);
+	MiraTxFlow* select(uint8_t txClass);
+	void advance(uint8_t txClass);
+	static void getDestination(MiraOneMessage* message, IEEE_EUI64& destination);
+};
+
+#endif
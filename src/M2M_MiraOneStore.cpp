@@ -0,0 +1,271 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneStore.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraRecordStore::MiraRecordStore()
+{
+	_header = nullptr;
+	_slots = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Infrastructure
+//
+bool MiraRecordStore::begin(void* memory, size_t size, bool resume)
+{
+	// Slots hold 32-bit fields, Cortex-M0 faults on unaligned access
+	uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+	uintptr_t aligned = (start + 3) & ~static_cast<uintptr_t>(3);
+	if (memory == nullptr || size < aligned - start + getRequiredSize(1))
+	{
+		_header = nullptr;
+		_slots = nullptr;
+		return false;
+	}
+	size -= aligned - start;
+	_header = reinterpret_cast<MiraStoreHeader*>(aligned);
+	_slots = reinterpret_cast<MiraStoreSlot*>(aligned + sizeof(MiraStoreHeader));
+	uint32_t slotCount = (size - sizeof(MiraStoreHeader)) / sizeof(MiraStoreSlot);
+	if (resume &&
+		_header->magic == MIRA_STORE_MAGIC &&
+		_header->version == MIRA_STORE_VERSION &&
+		_header->slotSize == sizeof(MiraStoreSlot) &&
+		_header->slotCount == slotCount &&
+		_header->nextSequence != MIRA_STORE_NONE)
+	{
+		return true;
+	}
+	_header->magic = MIRA_STORE_MAGIC;
+	_header->version = MIRA_STORE_VERSION;
+	_header->slotSize = sizeof(MiraStoreSlot);
+	_header->slotCount = slotCount;
+	clear();
+	return true;
+}
+
+void MiraRecordStore::clear()
+{
+	if (_header == nullptr)
+	{
+		return;
+	}
+	_header->nextSequence = 1;
+	_header->committed = MIRA_STORE_NONE;
+	_header->truncated = 0;
+	memset(_header->nodes, 0, sizeof(_header->nodes));
+}
+
+size_t MiraRecordStore::getRequiredSize(uint32_t slotCount)
+{
+	return sizeof(MiraStoreHeader) + slotCount * sizeof(MiraStoreSlot);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Records
+//
+uint32_t MiraRecordStore::append(uint32_t timestamp, const IEEE_EUI64& address, const uint8_t* data, uint8_t length)
+{
+	if (_header == nullptr)
+	{
+		return MIRA_STORE_NONE;
+	}
+	uint32_t sequence = _header->nextSequence;
+	MiraStoreSlot* slot = getSlot(sequence);
+	MiraStoreNode* node = findNode(address);
+	if (length > MIRA_STORE_DATA_SIZE)
+	{
+		length = MIRA_STORE_DATA_SIZE;
+		_header->truncated++;
+	}
+	// Marked free while it is written, a record cut short by a crash is not read after resume
+	slot->sequence = MIRA_STORE_NONE;
+	slot->timestamp = timestamp;
+	slot->previous = node->sequence;
+	slot->address = address;
+	slot->length = length;
+	slot->flags = 0;
+	memcpy(slot->data, data, length);
+	slot->sequence = sequence;
+	node->address = address;
+	node->sequence = sequence;
+	_header->nextSequence = sequence + 1;
+	return sequence;
+}
+
+bool MiraRecordStore::read(uint32_t& cursor, MiraStoreRecord& record)
+{
+	if (_header == nullptr)
+	{
+		return false;
+	}
+	uint32_t first = getFirstSequence();
+	if (cursor < first)
+	{
+		cursor = first;
+	}
+	while (cursor < _header->nextSequence)
+	{
+		const MiraStoreSlot* slot = getSlot(cursor++);
+		if (slot->sequence == cursor - 1)
+		{
+			fillRecord(slot, record);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MiraRecordStore::readSequence(uint32_t sequence, MiraStoreRecord& record)
+{
+	if (_header == nullptr || sequence < getFirstSequence() || sequence >= _header->nextSequence)
+	{
+		return false;
+	}
+	const MiraStoreSlot* slot = getSlot(sequence);
+	if (slot->sequence != sequence)
+	{
+		return false;
+	}
+	fillRecord(slot, record);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Nodes
+//
+bool MiraRecordStore::readLatest(const IEEE_EUI64& address, MiraStoreRecord& record)
+{
+	if (_header == nullptr)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < MIRA_STORE_NODES; i++)
+	{
+		MiraStoreNode* node = &_header->nodes[i];
+		if (node->sequence != MIRA_STORE_NONE && memcmp(&node->address, &address, sizeof(IEEE_EUI64)) == 0)
+		{
+			return readSequence(node->sequence, record);
+		}
+	}
+	return false;
+}
+
+bool MiraRecordStore::readPrevious(MiraStoreRecord& record)
+{
+	// Walks back through the records of the node in record, false at the oldest one kept
+	IEEE_EUI64 address = record.address;
+	if (record.previous == MIRA_STORE_NONE || !readSequence(record.previous, record))
+	{
+		return false;
+	}
+	return memcmp(&record.address, &address, sizeof(IEEE_EUI64)) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property setters
+//
+void MiraRecordStore::setCommitted(uint32_t sequence)
+{
+	if (_header != nullptr)
+	{
+		_header->committed = sequence;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint32_t MiraRecordStore::getCommitted()
+{
+	return _header != nullptr ? _header->committed : MIRA_STORE_NONE;
+}
+
+uint32_t MiraRecordStore::getFirstSequence()
+{
+	if (_header == nullptr)
+	{
+		return MIRA_STORE_NONE;
+	}
+	uint32_t next = _header->nextSequence;
+	return next > _header->slotCount ? next - _header->slotCount : 1;
+}
+
+uint32_t MiraRecordStore::getNextSequence()
+{
+	return _header != nullptr ? _header->nextSequence : MIRA_STORE_NONE;
+}
+
+uint32_t MiraRecordStore::getCount()
+{
+	return _header != nullptr ? _header->nextSequence - getFirstSequence() : 0;
+}
+
+uint32_t MiraRecordStore::getCapacity()
+{
+	return _header != nullptr ? _header->slotCount : 0;
+}
+
+uint32_t MiraRecordStore::getTruncatedCount()
+{
+	return _header != nullptr ? _header->truncated : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraStoreSlot* MiraRecordStore::getSlot(uint32_t sequence)
+{
+	return &_slots[sequence % _header->slotCount];
+}
+
+MiraStoreNode* MiraRecordStore::findNode(const IEEE_EUI64& address)
+{
+	// Falls back to the entry that was updated longest ago
+	MiraStoreNode* oldest = &_header->nodes[0];
+	for (uint8_t i = 0; i < MIRA_STORE_NODES; i++)
+	{
+		MiraStoreNode* node = &_header->nodes[i];
+		if (node->sequence != MIRA_STORE_NONE && memcmp(&node->address, &address, sizeof(IEEE_EUI64)) == 0)
+		{
+			return node;
+		}
+		if (node->sequence < oldest->sequence)
+		{
+			oldest = node;
+		}
+	}
+	oldest->sequence = MIRA_STORE_NONE;
+	return oldest;
+}
+
+void MiraRecordStore::fillRecord(const MiraStoreSlot* slot, MiraStoreRecord& record)
+{
+	record.sequence = slot->sequence;
+	record.timestamp = slot->timestamp;
+	record.previous = slot->previous;
+	record.address = slot->address;
+	record.data = slot->data;
+	record.length = slot->length;
+}
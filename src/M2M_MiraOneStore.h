@@ -0,0 +1,152 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Fixed size ring of received readings, so a gateway can replay history after an uplink
+// outage.
+//
+// The store lives in a memory region given to begin(), a static buffer on a microcontroller
+// or a memory mapped file on Linux (see MiraMappedStore). The region holds a header followed
+// by fixed size slots. Every record gets a sequence number and is stored in slot
+// sequence % slots, so append and seeking to a sequence are O(1). When the ring is full the
+// oldest record is overwritten, nothing is allocated.
+//
+// A cursor is a sequence number. read() returns the record at the cursor and advances it,
+// a cursor that has fallen behind the oldest record skips ahead. The committed sequence is
+// kept in the header, so a gateway can store how far the uplink got and resume from there.
+//
+// Each record links to the previous record from the same node, and a small table holds the
+// latest sequence of recently seen nodes, so the history of one node can be walked
+// without scanning the whole ring.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONESTORE_h__
+#define __M2M_MIRAONESTORE_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_STORE_DATA_SIZE
+#ifdef MIRA_HOST_BUILD
+#define MIRA_STORE_DATA_SIZE		236		// Payload bytes per slot, longer payloads are cut
+#else
+#define MIRA_STORE_DATA_SIZE		44
+#endif
+#endif
+
+#ifndef MIRA_STORE_NODES
+#ifdef MIRA_HOST_BUILD
+#define MIRA_STORE_NODES			64		// Nodes in the index hint table
+#else
+#define MIRA_STORE_NODES			8
+#endif
+#endif
+
+#define MIRA_STORE_MAGIC			0x5352494d	// "MIRS"
+#define MIRA_STORE_VERSION			1
+#define MIRA_STORE_NONE				0		// Sequence numbers start at 1
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+struct MiraStoreSlot
+{
+	uint32_t sequence;
+	uint32_t timestamp;
+	uint32_t previous;		// Previous sequence from the same node, or MIRA_STORE_NONE
+	IEEE_EUI64 address;
+	uint8_t length;
+	uint8_t flags;
+	uint8_t reserved[2];
+	uint8_t data[MIRA_STORE_DATA_SIZE];
+};
+
+struct MiraStoreNode
+{
+	IEEE_EUI64 address;
+	uint32_t sequence;		// Latest record from the node
+};
+
+struct MiraStoreHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slotSize;
+	uint32_t slotCount;
+	uint32_t nextSequence;
+	uint32_t committed;		// Set by the application, kept with the records
+	uint32_t truncated;
+	MiraStoreNode nodes[MIRA_STORE_NODES];
+};
+
+struct MiraStoreRecord
+{
+	uint32_t sequence;
+	uint32_t timestamp;
+	uint32_t previous;
+	IEEE_EUI64 address;
+	const uint8_t* data;	// Valid until the slot is overwritten
+	uint8_t length;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraRecordStore
+{
+public:
+	// Constructor
+	MiraRecordStore();
+
+	// Infrastructure
+	bool begin(void* memory, size_t size, bool resume = false);
+	void clear();
+	static size_t getRequiredSize(uint32_t slotCount);
+
+	// Records
+	uint32_t append(uint32_t timestamp, const IEEE_EUI64& address, const uint8_t* data, uint8_t length);
+	bool read(uint32_t& cursor, MiraStoreRecord& record);
+	bool readSequence(uint32_t sequence, MiraStoreRecord& record);
+
+	// Nodes
+	bool readLatest(const IEEE_EUI64& address, MiraStoreRecord& record);
+	bool readPrevious(MiraStoreRecord& record);
+
+	// Property setters
+	void setCommitted(uint32_t sequence);
+
+	// Property getters
+	uint32_t getCommitted();
+	uint32_t getFirstSequence();
+	uint32_t getNextSequence();
+	uint32_t getCount();
+	uint32_t getCapacity();
+	uint32_t getTruncatedCount();
+
+protected:
+	MiraStoreHeader* _header;
+	MiraStoreSlot* _slots;
+
+private:
+	MiraStoreSlot* getSlot(uint32_t sequence);
+	MiraStoreNode* findNode(const IEEE_EUI64& address);
+	void fillRecord(const MiraStoreSlot* slot, MiraStoreRecord& record);
+};
+
+#endif
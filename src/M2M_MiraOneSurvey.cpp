@@ -0,0 +1,256 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneSurvey.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraPingSurvey::MiraPingSurvey(MiraOne& mira)
+{
+	_mira = &mira;
+	for (uint8_t i = 0; i < MIRA_SURVEY_MAX_IN_FLIGHT; i++)
+	{
+		_slots[i].survey = this;
+		_slots[i].active = false;
+	}
+}
+
+MiraPingSurvey::~MiraPingSurvey()
+{
+	cancel();
+	release();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Survey
+//
+bool MiraPingSurvey::begin(const IEEE_EUI64* nodes, uint16_t count, uint8_t pings, uint8_t inFlight)
+{
+	cancel();
+	release();
+	if (count == 0 || pings == 0)
+	{
+		return false;
+	}
+	_nodes = new MiraSurveyNode[count];
+	_samples = new uint16_t[static_cast<uint32_t>(count) * pings];
+	for (uint16_t i = 0; i < count; i++)
+	{
+		_nodes[i].address = nodes[i];
+		_nodes[i].samples = &_samples[static_cast<uint32_t>(i) * pings];
+		_nodes[i].sent = 0;
+		_nodes[i].received = 0;
+		_nodes[i].sorted = true;
+	}
+	_count = count;
+	_pings = pings;
+	_window = inFlight < 1 ? 1 : inFlight > MIRA_SURVEY_MAX_IN_FLIGHT ? MIRA_SURVEY_MAX_IN_FLIGHT : inFlight;
+	_next = 0;
+	_startedAt = millis();
+	_finishedAt = 0;
+	return true;
+}
+
+bool MiraPingSurvey::update()
+{
+	// Returns true while the survey is running
+	uint32_t total = static_cast<uint32_t>(_count) * _pings;
+	while (_inFlight < _window && _next < total)
+	{
+		MiraSurveySlot* slot = findFreeSlot();
+		if (slot == nullptr)
+		{
+			break;
+		}
+		uint16_t node = _next % _count;
+		MiraOneMessage* message = MiraOneMessage::getNetworkPingMessage(_nodes[node].address);
+		slot->sentAt = millis();
+		bool sent = _mira->sendRequest(message, onResponse, slot, 1, MIRA_MESSAGE_TYPE_NETWORK_PONG, &_nodes[node].address);
+		delete message;
+		if (!sent)
+		{
+			// No free request or transmit queue full, tried again on the next update
+			break;
+		}
+		slot->node = node;
+		slot->answered = false;
+		slot->active = true;
+		_nodes[node].sent++;
+		_inFlight++;
+		_next++;
+	}
+	if (isDone())
+	{
+		if (_finishedAt == 0 && _count > 0)
+		{
+			_finishedAt = millis();
+		}
+		return false;
+	}
+	return true;
+}
+
+void MiraPingSurvey::cancel()
+{
+	// Pings in flight are forgotten by MiraOne and count as lost
+	for (uint8_t i = 0; i < MIRA_SURVEY_MAX_IN_FLIGHT; i++)
+	{
+		if (_slots[i].active)
+		{
+			_mira->cancelRequest(onResponse, &_slots[i]);
+			_slots[i].active = false;
+		}
+	}
+	_inFlight = 0;
+	_next = static_cast<uint32_t>(_count) * _pings;
+}
+
+bool MiraPingSurvey::isDone()
+{
+	return _inFlight == 0 && _next >= static_cast<uint32_t>(_count) * _pings;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Results
+//
+uint16_t MiraPingSurvey::getNodeCount()
+{
+	return _count;
+}
+
+bool MiraPingSurvey::getResult(uint16_t index, MiraSurveyResult& result)
+{
+	if (index >= _count)
+	{
+		return false;
+	}
+	MiraSurveyNode* node = &_nodes[index];
+	if (!node->sorted)
+	{
+		// Insertion sort, a node has few samples and they arrive nearly in order
+		for (uint8_t i = 1; i < node->received; i++)
+		{
+			uint16_t value = node->samples[i];
+			uint8_t j = i;
+			while (j > 0 && node->samples[j - 1] > value)
+			{
+				node->samples[j] = node->samples[j - 1];
+				j--;
+			}
+			node->samples[j] = value;
+		}
+		node->sorted = true;
+	}
+	result.address = node->address;
+	result.sent = node->sent;
+	result.received = node->received;
+	result.loss = node->sent > 0 ? static_cast<float>(node->sent - node->received) / node->sent : 0.0f;
+	if (node->received == 0)
+	{
+		result.min = 0;
+		result.median = 0;
+		result.p99 = 0;
+		result.max = 0;
+		return true;
+	}
+	result.min = node->samples[0];
+	result.median = getPercentile(node->samples, node->received, 50);
+	result.p99 = getPercentile(node->samples, node->received, 99);
+	result.max = node->samples[node->received - 1];
+	return true;
+}
+
+uint16_t MiraPingSurvey::getReachableCount()
+{
+	uint16_t result = 0;
+	for (uint16_t i = 0; i < _count; i++)
+	{
+		if (_nodes[i].received > 0)
+		{
+			result++;
+		}
+	}
+	return result;
+}
+
+uint32_t MiraPingSurvey::getElapsed()
+{
+	return (_finishedAt != 0 ? _finishedAt : millis()) - _startedAt;
+}
+
+uint8_t MiraPingSurvey::getInFlight()
+{
+	return _inFlight;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+MiraSurveySlot* MiraPingSurvey::findFreeSlot()
+{
+	for (uint8_t i = 0; i < MIRA_SURVEY_MAX_IN_FLIGHT; i++)
+	{
+		if (!_slots[i].active)
+		{
+			return &_slots[i];
+		}
+	}
+	return nullptr;
+}
+
+void MiraPingSurvey::release()
+{
+	delete[] _nodes;
+	delete[] _samples;
+	_nodes = nullptr;
+	_samples = nullptr;
+	_count = 0;
+	_next = 0;
+}
+
+void MiraPingSurvey::onResponse(void* context, MiraOneMessage* response, bool done)
+{
+	// Called with the ACK, then the PONG, or nullptr when the request timed out
+	MiraSurveySlot* slot = static_cast<MiraSurveySlot*>(context);
+	MiraPingSurvey* self = slot->survey;
+	if (!slot->active)
+	{
+		return;
+	}
+	if (response != nullptr && !slot->answered && response->getMessageType() == MIRA_MESSAGE_TYPE_NETWORK_PONG)
+	{
+		MiraSurveyNode* node = &self->_nodes[slot->node];
+		uint32_t roundTrip = millis() - slot->sentAt;
+		node->samples[node->received++] = roundTrip > 0xffff ? 0xffff : static_cast<uint16_t>(roundTrip);
+		node->sorted = false;
+		slot->answered = true;
+	}
+	if (done)
+	{
+		slot->active = false;
+		self->_inFlight--;
+	}
+}
+
+uint16_t MiraPingSurvey::getPercentile(const uint16_t* sorted, uint8_t count, uint8_t percent)
+{
+	// Nearest rank
+	uint16_t rank = (static_cast<uint16_t>(count) * percent + 99) / 100;
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
@@ -0,0 +1,126 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Mesh latency survey, pinging a list of nodes with several pings in flight.
+//
+// begin() takes the node addresses and the number of pings per node. update() is called
+// from the loop after MiraOne::update() and keeps up to the given number of pings in flight
+// through MiraOne::sendRequest(), one round over all nodes at a time so that no node gets
+// its pings back to back. PONGs are matched to their ping by address as they arrive. Pings
+// without a PONG before the request times out count as lost.
+//
+// getResult() gives min, median, 99th percentile and max round trip in ms, and the loss,
+// for a node. Round trips are measured from when the ping is queued.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONESURVEY_h__
+#define __M2M_MIRAONESURVEY_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOne.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_SURVEY_MAX_IN_FLIGHT
+#ifdef MIRA_HOST_BUILD
+#define MIRA_SURVEY_MAX_IN_FLIGHT	64		// Also limited by MIRA_MAX_REQUESTS
+#else
+#define MIRA_SURVEY_MAX_IN_FLIGHT	4
+#endif
+#endif
+#define MIRA_SURVEY_IN_FLIGHT		8		// Default
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+struct MiraSurveyResult
+{
+	IEEE_EUI64 address;
+	uint8_t sent;
+	uint8_t received;
+	uint16_t min;			// ms, 0 when nothing was received
+	uint16_t median;
+	uint16_t p99;
+	uint16_t max;
+	float loss;				// 0.0 - 1.0 of the pings sent
+};
+
+struct MiraSurveyNode
+{
+	IEEE_EUI64 address;
+	uint16_t* samples;		// Round trips received, pings long
+	uint8_t sent;
+	uint8_t received;
+	bool sorted;
+};
+
+class MiraPingSurvey;
+
+struct MiraSurveySlot
+{
+	MiraPingSurvey* survey;
+	uint32_t sentAt;
+	uint16_t node;
+	bool answered;
+	bool active;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraPingSurvey
+{
+public:
+	// Constructor/Destructor
+	MiraPingSurvey(MiraOne& mira);
+	~MiraPingSurvey();
+
+	// Survey
+	bool begin(const IEEE_EUI64* nodes, uint16_t count, uint8_t pings = 5, uint8_t inFlight = MIRA_SURVEY_IN_FLIGHT);
+	bool update();
+	void cancel();
+	bool isDone();
+
+	// Results
+	uint16_t getNodeCount();
+	bool getResult(uint16_t node, MiraSurveyResult& result);
+	uint16_t getReachableCount();
+	uint32_t getElapsed();
+	uint8_t getInFlight();
+
+private:
+	MiraOne* _mira;
+	MiraSurveyNode* _nodes = nullptr;
+	uint16_t* _samples = nullptr;
+	uint16_t _count = 0;
+	uint8_t _pings = 0;
+	uint8_t _window = 0;
+	uint8_t _inFlight = 0;
+	uint32_t _next = 0;			// Next ping, round * count + node
+	uint32_t _startedAt = 0;
+	uint32_t _finishedAt = 0;
+	MiraSurveySlot _slots[MIRA_SURVEY_MAX_IN_FLIGHT];
+
+	// Private functions
+	MiraSurveySlot* findFreeSlot();
+	void release();
+	static void onResponse(void* context, MiraOneMessage* response, bool done);
+	static uint16_t getPercentile(const uint16_t* sorted, uint8_t count, uint8_t percent);
+};
+
+#endif
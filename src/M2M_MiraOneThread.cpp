@@ -0,0 +1,310 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneThread.h"
+
+#ifdef MIRA_HOST_BUILD
+
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+static_assert((MIRA_THREAD_RX_RING_SIZE & (MIRA_THREAD_RX_RING_SIZE - 1)) == 0,
+	"MIRA_THREAD_RX_RING_SIZE must be a power of two");
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor/Destructor
+//
+MiraOneThread::MiraOneThread(MiraOne& mira, MiraPosixSerial& port)
+{
+	_mira = &mira;
+	_port = &port;
+	_running = false;
+	_txStub.next = nullptr;
+	_txHead = &_txStub;
+	_txTail = &_txStub;
+	_txCount = 0;
+	_rxHead = 0;
+	_rxTail = 0;
+	_rxWaiting = false;
+	_rxDropped = 0;
+}
+
+MiraOneThread::~MiraOneThread()
+{
+	stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Infrastructure
+//
+bool MiraOneThread::start()
+{
+	if (_running)
+	{
+		return true;
+	}
+#ifdef __linux__
+	_wakeRead = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_wakeWrite = _wakeRead;
+	if (_wakeRead < 0)
+	{
+		return false;
+	}
+#else
+	int fds[2];
+	if (pipe(fds) < 0)
+	{
+		return false;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	_wakeRead = fds[0];
+	_wakeWrite = fds[1];
+#endif
+	_running = true;
+	_thread = std::thread(&MiraOneThread::run, this);
+	return true;
+}
+
+void MiraOneThread::stop()
+{
+	if (!_running)
+	{
+		return;
+	}
+	_running = false;
+	wake();
+	_thread.join();
+	if (_wakeWrite != _wakeRead)
+	{
+		close(_wakeWrite);
+	}
+	close(_wakeRead);
+	_wakeRead = -1;
+	_wakeWrite = -1;
+	// Frames not handed over are discarded
+	if (_txPending != nullptr)
+	{
+		delete _txPending->message;
+		delete _txPending;
+		_txPending = nullptr;
+	}
+	MiraThreadNode* node;
+	while ((node = popTx()) != nullptr)
+	{
+		delete node->message;
+		delete node;
+	}
+	MiraOneMessage* message;
+	while ((message = getNextMessage()) != nullptr)
+	{
+		delete message;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Messaging
+//
+MiraSendResult MiraOneThread::send(MiraOneMessage* message)
+{
+	return send(message, MiraTxScheduler::getDefaultClass(message));
+}
+
+MiraSendResult MiraOneThread::send(MiraOneMessage* message, MiraTxClass txClass)
+{
+	// The caller keeps ownership of message, as with MiraOne::send()
+	if (_txCount.fetch_add(1) >= MIRA_THREAD_TX_QUEUE_SIZE)
+	{
+		_txCount--;
+		return MiraSendResult::wouldBlock;
+	}
+	MiraThreadNode* node = new MiraThreadNode();
+	node->next = nullptr;
+	node->message = new MiraOneMessage(*message);
+	node->txClass = txClass;
+	MiraThreadNode* previous = _txHead.exchange(node, std::memory_order_acq_rel);
+	previous->next.store(node, std::memory_order_release);
+	wake();
+	return MiraSendResult::ok;
+}
+
+MiraOneMessage* MiraOneThread::getNextMessage(int timeoutMillis)
+{
+	uint32_t tail = _rxTail.load(std::memory_order_relaxed);
+	if (tail == _rxHead.load(std::memory_order_acquire))
+	{
+		if (timeoutMillis <= 0)
+		{
+			return nullptr;
+		}
+		std::unique_lock<std::mutex> lock(_rxMutex);
+		_rxWaiting = true;
+		_rxCondition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), [this, tail] {
+			return tail != _rxHead.load() || !_running;
+		});
+		_rxWaiting = false;
+		if (tail == _rxHead.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+	}
+	MiraOneMessage* result = _rxRing[tail & (MIRA_THREAD_RX_RING_SIZE - 1)];
+	_rxTail.store(tail + 1, std::memory_order_release);
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint32_t MiraOneThread::getDroppedCount()
+{
+	return _rxDropped;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Private functions
+//
+void MiraOneThread::run()
+{
+	struct pollfd descriptors[2];
+	descriptors[0].fd = _port->getFd();
+	descriptors[0].events = POLLIN;
+	descriptors[1].fd = _wakeRead;
+	descriptors[1].events = POLLIN;
+	while (_running)
+	{
+		if (_port->available() == 0)
+		{
+			poll(descriptors, 2, MIRA_THREAD_POLL_INTERVAL);
+		}
+		clearWake();
+		serviceTx();
+		_mira->update();
+		serviceRx();
+	}
+}
+
+void MiraOneThread::wake()
+{
+	uint64_t value = 1;
+	if (write(_wakeWrite, &value, _wakeWrite == _wakeRead ? sizeof(value) : 1) < 0)
+	{
+		// Already signalled
+	}
+}
+
+void MiraOneThread::clearWake()
+{
+	uint64_t value;
+	while (read(_wakeRead, &value, sizeof(value)) > 0)
+	{
+	}
+}
+
+MiraThreadNode* MiraOneThread::popTx()
+{
+	// Vyukov's intrusive MPSC queue, _txTail is only touched by the I/O thread
+	MiraThreadNode* tail = _txTail;
+	MiraThreadNode* next = tail->next.load(std::memory_order_acquire);
+	if (tail == &_txStub)
+	{
+		if (next == nullptr)
+		{
+			return nullptr;
+		}
+		_txTail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next != nullptr)
+	{
+		_txTail = next;
+		return tail;
+	}
+	if (tail != _txHead.load(std::memory_order_acquire))
+	{
+		// A producer is between exchange and link, try again on the next pass
+		return nullptr;
+	}
+	_txStub.next.store(nullptr, std::memory_order_relaxed);
+	MiraThreadNode* previous = _txHead.exchange(&_txStub, std::memory_order_acq_rel);
+	previous->next.store(&_txStub, std::memory_order_release);
+	next = tail->next.load(std::memory_order_acquire);
+	if (next != nullptr)
+	{
+		_txTail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+void MiraOneThread::serviceTx()
+{
+	while (true)
+	{
+		if (_txPending == nullptr)
+		{
+			_txPending = popTx();
+			if (_txPending == nullptr)
+			{
+				return;
+			}
+		}
+		// Frames refused by the send window are retried in order on the next pass
+		if (_mira->send(_txPending->message, _txPending->txClass) != MiraSendResult::ok)
+		{
+			return;
+		}
+		delete _txPending->message;
+		delete _txPending;
+		_txPending = nullptr;
+		_txCount--;
+	}
+}
+
+void MiraOneThread::serviceRx()
+{
+	bool pushed = false;
+	MiraOneMessage* message;
+	while ((message = _mira->getQueuedMessage()) != nullptr)
+	{
+		uint32_t head = _rxHead.load(std::memory_order_relaxed);
+		if (head - _rxTail.load(std::memory_order_acquire) >= MIRA_THREAD_RX_RING_SIZE)
+		{
+			delete message;
+			_rxDropped++;
+			continue;
+		}
+		_rxRing[head & (MIRA_THREAD_RX_RING_SIZE - 1)] = message;
+		_rxHead.store(head + 1);
+		pushed = true;
+	}
+	if (pushed && _rxWaiting)
+	{
+		std::lock_guard<std::mutex> lock(_rxMutex);
+		_rxCondition.notify_one();
+	}
+}
+
+#endif
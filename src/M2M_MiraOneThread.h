@@ -0,0 +1,126 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Threaded host mode.
+//
+// A dedicated I/O thread owns the serial port and the MiraOne instance. It waits for serial
+// data or outbound frames with poll(), runs MiraOne::update() and hands received frames to
+// the application through a lock-free single producer/single consumer ring.
+//
+// Any number of application threads can call send(). Frames are passed to the I/O thread
+// through a lock-free multiple producer/single consumer queue and the thread is woken with
+// an eventfd (a pipe on hosts without eventfd).
+//
+// getNextMessage() must only be called from one thread. Once start() has been called, the
+// MiraOne instance must not be used directly by the application, and the delivery and
+// watchdog callbacks run on the I/O thread.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONETHREAD_h__
+#define __M2M_MIRAONETHREAD_h__
+
+#include "M2M_MiraOnePosixSerial.h"
+
+#ifdef MIRA_HOST_BUILD
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "M2M_MiraOne.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+#ifndef MIRA_THREAD_RX_RING_SIZE
+#define MIRA_THREAD_RX_RING_SIZE	256		// Must be a power of two
+#endif
+
+#ifndef MIRA_THREAD_TX_QUEUE_SIZE
+#define MIRA_THREAD_TX_QUEUE_SIZE	256
+#endif
+
+#define MIRA_THREAD_POLL_INTERVAL	10		// ms, upper bound for timer driven work
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Struct definitions
+//
+struct MiraThreadNode
+{
+	std::atomic<MiraThreadNode*> next;
+	MiraOneMessage* message;
+	MiraTxClass txClass;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraOneThread
+{
+public:
+	// Constructor/Destructor
+	MiraOneThread(MiraOne& mira, MiraPosixSerial& port);
+	~MiraOneThread();
+
+	// Infrastructure
+	bool start();
+	void stop();
+
+	// Messaging, send() is safe to call from any thread
+	MiraSendResult send(MiraOneMessage* message);
+	MiraSendResult send(MiraOneMessage* message, MiraTxClass txClass);
+	MiraOneMessage* getNextMessage(int timeoutMillis = 0);
+
+	// Property getters
+	uint32_t getDroppedCount();
+
+private:
+	MiraOne* _mira;
+	MiraPosixSerial* _port;
+	std::thread _thread;
+	std::atomic<bool> _running;
+	int _wakeRead = -1;
+	int _wakeWrite = -1;
+
+	// Outbound MPSC queue, producers push at _txHead, the I/O thread pops at _txTail
+	MiraThreadNode _txStub;
+	std::atomic<MiraThreadNode*> _txHead;
+	MiraThreadNode* _txTail;
+	MiraThreadNode* _txPending = nullptr;
+	std::atomic<uint32_t> _txCount;
+
+	// Inbound SPSC ring, written by the I/O thread only
+	MiraOneMessage* _rxRing[MIRA_THREAD_RX_RING_SIZE];
+	std::atomic<uint32_t> _rxHead;
+	std::atomic<uint32_t> _rxTail;
+	std::atomic<bool> _rxWaiting;
+	std::atomic<uint32_t> _rxDropped;
+	std::mutex _rxMutex;
+	std::condition_variable _rxCondition;
+
+	// Private functions
+	void run();
+	void wake();
+	void clearWake();
+	MiraThreadNode* popTx();
+	void serviceTx();
+	void serviceRx();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include "M2M_MiraOneTxRing.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Constructor
+//
+MiraTxRing::MiraTxRing()
+{
+	clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Print
+//
+size_t MiraTxRing::write(uint8_t value)
+{
+	return write(&value, 1);
+}
+
+size_t MiraTxRing::write(const uint8_t* buffer, size_t size)
+{
+	// Nothing is taken once a byte of the frame has not fit, endFrame() rolls it back
+	if (_overflow || size > getFree())
+	{
+		_overflow = true;
+		return 0;
+	}
+	size_t first = MIRA_TX_RING_SIZE - _head;
+	if (first > size)
+	{
+		first = size;
+	}
+	memcpy(&_buffer[_head], buffer, first);
+	memcpy(_buffer, &buffer[first], size - first);
+	_head = (_head + size) % MIRA_TX_RING_SIZE;
+	_count += size;
+	return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Frames
+//
+void MiraTxRing::beginFrame()
+{
+	_frameHead = _head;
+	_frameCount = _count;
+	_overflow = false;
+}
+
+bool MiraTxRing::endFrame()
+{
+	// Only bytes written since beginFrame() are dropped, drain() takes from the tail
+	if (!_overflow)
+	{
+		return true;
+	}
+	uint16_t added = _count - _frameCount;
+	_head = _frameHead;
+	_count -= added;
+	_overflow = false;
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Draining
+//
+size_t MiraTxRing::drain(Print* output, size_t limit)
+{
+	size_t drained = 0;
+	while (drained < limit && _count > 0)
+	{
+		size_t length = MIRA_TX_RING_SIZE - _tail;
+		if (length > _count)
+		{
+			length = _count;
+		}
+		if (length > limit - drained)
+		{
+			length = limit - drained;
+		}
+		size_t written = output->write(&_buffer[_tail], length);
+		_tail = (_tail + written) % MIRA_TX_RING_SIZE;
+		_count -= written;
+		drained += written;
+		if (written < length)
+		{
+			break;
+		}
+	}
+	return drained;
+}
+
+void MiraTxRing::clear()
+{
+	_head = 0;
+	_tail = 0;
+	_count = 0;
+	_frameHead = 0;
+	_frameCount = 0;
+	_overflow = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Property getters
+//
+uint16_t MiraTxRing::getCount()
+{
+	return _count;
+}
+
+uint16_t MiraTxRing::getFree()
+{
+	return MIRA_TX_RING_SIZE - _count;
+}
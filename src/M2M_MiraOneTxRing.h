@@ -0,0 +1,83 @@
+//---------------------------------------------------------------------------------------------
+//
+// Library for the Lumenradio MiraOne radio module.
+//
+// Copyright 2018, M2M Solutions AB
+//
+// Licensed under the MIT license, see the LICENSE.txt file.
+//
+//---------------------------------------------------------------------------------------------
+//
+// Transmit byte ring between frame encoding and the UART.
+//
+// Frames are escaped straight into the ring, which is a Print. beginFrame() marks where a
+// frame starts, endFrame() keeps it if every byte fit and rolls the ring back to the mark if
+// not, so a frame is either queued whole or not at all. drain() hands at most the given
+// number of bytes to the output, in at most two writes. The ring holds at least one frame of
+// the largest size escaped, so a frame always fits once the ring has drained.
+//
+//---------------------------------------------------------------------------------------------
+#ifndef __M2M_MIRAONETXRING_h__
+#define __M2M_MIRAONETXRING_h__
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Includes
+//
+#include <Arduino.h>
+#include "M2M_MiraOneMessage.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Internal defines
+//
+// STC, then header, EUI64 address, 255 data bytes and CRC with every byte escaped
+#define MIRA_TX_MAX_FRAME_SIZE	(1 + 2 * (4 + 1 + sizeof(IEEE_EUI64) + 255 + 2))
+
+#ifndef MIRA_TX_RING_SIZE
+#ifdef MIRA_HOST_BUILD
+#define MIRA_TX_RING_SIZE		2048	// Encoded bytes waiting for the UART
+#else
+#define MIRA_TX_RING_SIZE		544
+#endif
+#endif
+
+static_assert(MIRA_TX_RING_SIZE >= MIRA_TX_MAX_FRAME_SIZE, "MIRA_TX_RING_SIZE must hold the largest escaped frame");
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Class definitions
+//
+class MiraTxRing : public Print
+{
+public:
+	// Constructor
+	MiraTxRing();
+
+	// Print
+	size_t write(uint8_t value) override;
+	size_t write(const uint8_t* buffer, size_t size) override;
+
+	// Frames
+	void beginFrame();
+	bool endFrame();
+
+	// Draining
+	size_t drain(Print* output, size_t limit);
+	void clear();
+
+	// Property getters
+	uint16_t getCount();
+	uint16_t getFree();
+
+private:
+	uint8_t _buffer[MIRA_TX_RING_SIZE];
+	uint16_t _head;				// Next byte written
+	uint16_t _tail;				// Next byte drained
+	uint16_t _count;
+	uint16_t _frameHead;		// Head and count at beginFrame()
+	uint16_t _frameCount;
+	bool _overflow;
+};
+
+#endif